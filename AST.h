@@ -1,17 +1,44 @@
 #ifndef __AST_H__
 #define __AST_H__
+#include "ASTArena.h"
 #include "AllInclude.h"
+#include "FlatAST.h"
+#include "Symbol.h"
+
+class CodegenContext;
 //===----------------------------------------------------------------------===//
 // Abstract Syntax Tree (aka Parse Tree)
 //===----------------------------------------------------------------------===//
 //expr  prototype   function object
 //this can parser expr and functionbody
+//Expression nodes live in the ASTArena of their FunctionAST and point to their
+//children directly; they are freed with the arena, never one at a time.
 
 //ExprAST - Base class for all expression nodes
+//The kind tag lets passes use isa<>/dyn_cast<> (LLVM is built without RTTI).
 class ExprAST {
    public:
+    enum ExprKind { expr_number, expr_variable, expr_binary, expr_call, expr_if, expr_for };
+
+   private:
+    const ExprKind Kind;
+
+   public:
+    explicit ExprAST(ExprKind Kind) : Kind(Kind) {}
     virtual ~ExprAST() {}
-    virtual Value *codegen() = 0;
+    ExprKind getKind() const { return Kind; }
+    //codegen - dispatches on the kind to the codegen of the node class. Not
+    //virtual: the vtables would pull the code generator and all of LLVM into
+    //anything that builds an AST, like toy-vm
+    Value *codegen(CodegenContext &CG);
+    //flatten - append this subtree to Flat, return the index of its root
+    virtual FlatAST::NodeIdx flatten(FlatAST &Flat) const = 0;
+    //getOperands - the direct subexpressions, in evaluation order
+    virtual MutableArrayRef<ExprAST *> getOperands() = 0;
+    //simplify - fold constants and identities in this node, its operands have
+    //been simplified already. Return the node that replaces it (maybe itself),
+    //new nodes go into Arena.
+    virtual ExprAST *simplify(ASTArena &Arena) = 0;
 };
 
 //NumberExprAST - Expression class for numeric literals like "1.0"
@@ -19,66 +46,144 @@ class NumberExprAST : public ExprAST {
     double Val;
 
    public:
-    NumberExprAST(double Val) : Val(Val) {}
-    virtual Value *codegen();
+    NumberExprAST(double Val) : ExprAST(expr_number), Val(Val) {}
+    double getVal() const { return Val; }
+    Value *codegen(CodegenContext &CG);
+    virtual FlatAST::NodeIdx flatten(FlatAST &Flat) const;
+    virtual MutableArrayRef<ExprAST *> getOperands() { return None; }
+    virtual ExprAST *simplify(ASTArena &Arena);
+    static bool classof(const ExprAST *E) { return expr_number == E->getKind(); }
 };
 
 //VariableExprAST - Expression class for referencing a variable , like "a"
 class VariableExprAST : public ExprAST {
-    std::string Name;
+    SymbolID Name;
 
    public:
-    VariableExprAST(const std::string &Name) : Name(Name) {}
-    virtual Value *codegen();
+    VariableExprAST(SymbolID Name) : ExprAST(expr_variable), Name(Name) {}
+    SymbolID getName() const { return Name; }
+    Value *codegen(CodegenContext &CG);
+    virtual FlatAST::NodeIdx flatten(FlatAST &Flat) const;
+    virtual MutableArrayRef<ExprAST *> getOperands() { return None; }
+    virtual ExprAST *simplify(ASTArena &Arena);
+    static bool classof(const ExprAST *E) { return expr_variable == E->getKind(); }
 };
 
 //BinaryExprAST - Expression class for a binary operator
 //Note that there is no discussion about precedence of binary operators, lexical structure, etc.
 class BinaryExprAST : public ExprAST {
     char Op;
-    std::unique_ptr<ExprAST> LHS, RHS;
+    //LHS, RHS
+    ExprAST *Ops[2];
 
    public:
-    BinaryExprAST(char op, std::unique_ptr<ExprAST> LHS, std::unique_ptr<ExprAST> RHS)
-        : Op(op), LHS(std::move(LHS)), RHS(std::move(RHS)) {}
-    virtual Value *codegen();
+    BinaryExprAST(char op, ExprAST *LHS, ExprAST *RHS) : ExprAST(expr_binary), Op(op), Ops{LHS, RHS} {}
+    char getOp() const { return Op; }
+    ExprAST *getLHS() const { return Ops[0]; }
+    ExprAST *getRHS() const { return Ops[1]; }
+    Value *codegen(CodegenContext &CG);
+    virtual FlatAST::NodeIdx flatten(FlatAST &Flat) const;
+    virtual MutableArrayRef<ExprAST *> getOperands() { return Ops; }
+    virtual ExprAST *simplify(ASTArena &Arena);
+    static bool classof(const ExprAST *E) { return expr_binary == E->getKind(); }
 };
 
 //callExprAST - Expression class for function calls
 class CallExprAST : public ExprAST {
-    std::string Callee;
-    std::vector<std::unique_ptr<ExprAST>> Args;
+    SymbolID Callee;
+    //copied into the arena
+    MutableArrayRef<ExprAST *> Args;
 
    public:
-    CallExprAST(const std::string &Callee, std::vector<std::unique_ptr<ExprAST>> Args)
-        : Callee(Callee), Args(std::move(Args)) {}
-    virtual Value *codegen();
+    CallExprAST(SymbolID Callee, MutableArrayRef<ExprAST *> Args)
+        : ExprAST(expr_call), Callee(Callee), Args(Args) {}
+    SymbolID getCallee() const { return Callee; }
+    ArrayRef<ExprAST *> getArgs() const { return Args; }
+    Value *codegen(CodegenContext &CG);
+    virtual FlatAST::NodeIdx flatten(FlatAST &Flat) const;
+    virtual MutableArrayRef<ExprAST *> getOperands() { return Args; }
+    virtual ExprAST *simplify(ASTArena &Arena);
+    static bool classof(const ExprAST *E) { return expr_call == E->getKind(); }
+};
+
+//IfExprAST - Expression class for if/then/else, the else branch is required
+//Cond is true when it is neither 0 nor NaN.
+class IfExprAST : public ExprAST {
+    //Cond, Then, Else
+    ExprAST *Ops[3];
+
+   public:
+    IfExprAST(ExprAST *Cond, ExprAST *Then, ExprAST *Else) : ExprAST(expr_if), Ops{Cond, Then, Else} {}
+    ExprAST *getCond() const { return Ops[0]; }
+    ExprAST *getThen() const { return Ops[1]; }
+    ExprAST *getElse() const { return Ops[2]; }
+    Value *codegen(CodegenContext &CG);
+    virtual FlatAST::NodeIdx flatten(FlatAST &Flat) const;
+    virtual MutableArrayRef<ExprAST *> getOperands() { return Ops; }
+    virtual ExprAST *simplify(ASTArena &Arena);
+    static bool classof(const ExprAST *E) { return expr_if == E->getKind(); }
+};
+
+//ForExprAST - Expression class for a counted loop, for i = Start, End, Step in Body
+//Start, End and Step are evaluated once, then Body runs
+//max(0, ceil((End - Start) / Step)) times with i = Start + k * Step for k = 0, 1, ...
+//The loop evaluates to the sum of the Body values, in order (0 without iterations).
+class ForExprAST : public ExprAST {
+    SymbolID VarName;
+    //Start, End, Step, Body
+    ExprAST *Ops[4];
+
+   public:
+    ForExprAST(SymbolID VarName, ExprAST *Start, ExprAST *End, ExprAST *Step, ExprAST *Body)
+        : ExprAST(expr_for), VarName(VarName), Ops{Start, End, Step, Body} {}
+    SymbolID getVarName() const { return VarName; }
+    ExprAST *getStart() const { return Ops[0]; }
+    ExprAST *getEnd() const { return Ops[1]; }
+    ExprAST *getStep() const { return Ops[2]; }
+    ExprAST *getBody() const { return Ops[3]; }
+    Value *codegen(CodegenContext &CG);
+    virtual FlatAST::NodeIdx flatten(FlatAST &Flat) const;
+    virtual MutableArrayRef<ExprAST *> getOperands() { return Ops; }
+    virtual ExprAST *simplify(ASTArena &Arena);
+    static bool classof(const ExprAST *E) { return expr_for == E->getKind(); }
 };
 
 /// PrototypeAST - This class represents the "prototype" for a function,
 /// which captures its name, and its argument names (thus implicitly the number
 /// of arguments the function takes).
 class PrototypeAST {
-    std::string Name;
-    std::vector<std::string> Args;
+    SymbolID Name;
+    std::vector<SymbolID> Args;
 
    public:
-    PrototypeAST(const std::string &name, std::vector<std::string> Args)
+    PrototypeAST(SymbolID name, std::vector<SymbolID> Args)
         : Name(name), Args(std::move(Args)) {}
 
-    const std::string &getName() const { return Name; }
-    virtual Function *codegen();
+    SymbolID getName() const { return Name; }
+    SymbolID getArg(unsigned Idx) const { return Args[Idx]; }
+    size_t getNumArgs() const { return Args.size(); }
+    Function *codegen(CodegenContext &CG);
 };
 
 //FunctionAST - this class represents a function definition itself
+//it owns the arena holding the nodes of Body
 class FunctionAST {
+    std::unique_ptr<ASTArena> Arena;
     std::unique_ptr<PrototypeAST> Proto;
-    std::unique_ptr<ExprAST> Body;
+    ExprAST *Body;
 
    public:
-    FunctionAST(std::unique_ptr<PrototypeAST> Proto, std::unique_ptr<ExprAST> Body)
-        : Proto(std::move(Proto)), Body(std::move(Body)) {}
-    virtual Function *codegen();
+    FunctionAST(std::unique_ptr<ASTArena> Arena, std::unique_ptr<PrototypeAST> Proto, ExprAST *Body)
+        : Arena(std::move(Arena)), Proto(std::move(Proto)), Body(Body) {}
+    Function *codegen(CodegenContext &CG);
+    //flatten - the same definition with a FlatAST body and a copy of the prototype
+    std::unique_ptr<FlatFunctionAST> flatten() const;
+    //simplify - simplify the body in place, before codegen or flatten. The
+    //tree is walked with an explicit stack, any nesting depth is fine.
+    void simplify();
+
+    PrototypeAST &getProto() const { return *Proto; }
+    ExprAST *getBody() const { return Body; }
 };
 
 #endif
\ No newline at end of file
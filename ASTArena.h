@@ -0,0 +1,35 @@
+#ifndef __ASTARENA_H__
+#define __ASTARENA_H__
+#include "AllInclude.h"
+#include "llvm/Support/Allocator.h"
+
+/// ASTArena - bump allocator for the expression nodes of one top-level item.
+/// Nodes are carved out of large slabs one after another and never freed or
+/// destroyed one by one; dropping the arena releases the whole tree at once.
+/// So everything allocated here must be trivially destructible: nodes refer
+/// to their children with plain pointers, and lists (call arguments) are
+/// copied into the arena as well.
+class ASTArena {
+    BumpPtrAllocator Allocator;
+
+   public:
+    template <typename T, typename... ArgTs>
+    T *create(ArgTs &&... Args) {
+        return new (Allocator.Allocate<T>()) T(std::forward<ArgTs>(Args)...);
+    }
+
+    /// copyArray - a copy of Elts that lives as long as the arena
+    template <typename T>
+    MutableArrayRef<T> copyArray(ArrayRef<T> Elts) {
+        if (Elts.empty()) {
+            return MutableArrayRef<T>();
+        }
+        T *Mem = Allocator.Allocate<T>(Elts.size());
+        std::uninitialized_copy(Elts.begin(), Elts.end(), Mem);
+        return MutableArrayRef<T>(Mem, Elts.size());
+    }
+
+    size_t getBytesAllocated() const { return Allocator.getBytesAllocated(); }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "BatchEvaluator.h"
+#include "AST.h"
+#include "Error.h"
+#include "Optimize.h"
+#include "llvm/ADT/DenseSet.h"
+
+void BatchEvaluator::addDefinition(const FunctionAST &FnAST) {
+    Definitions[FnAST.getProto().getName()] = FnAST.flatten();
+}
+
+/// emitDefinitions - generate Name and every definition it calls, directly or
+/// not, into CG as internal functions the optimizer may inline. Calls to
+/// externs stay calls into the JIT.
+bool BatchEvaluator::emitDefinitions(CodegenContext &CG, SymbolID Name) {
+    SmallVector<SymbolID, 8> Worklist(1, Name);
+    DenseSet<SymbolID> Seen;
+    Seen.insert(Name);
+    while (!Worklist.empty()) {
+        auto It = Definitions.find(Worklist.pop_back_val());
+        if (It == Definitions.end()) {
+            continue;
+        }
+        FlatFunctionAST &Def = *It->second;
+        Function *F          = Def.codegen(CG);
+        if (!F) {
+            return false;
+        }
+        //a copy, the JIT already has the exported one
+        F->setLinkage(GlobalValue::InternalLinkage);
+        const FlatAST &Body = Def.getBody();
+        for (FlatAST::NodeIdx N = 0, E = Body.size(); N != E; ++N) {
+            if (flat_call == Body.getKind(N) && Seen.insert(Body.getSymbol(N)).second) {
+                Worklist.push_back(Body.getSymbol(N));
+            }
+        }
+    }
+    return true;
+}
+
+BatchKernel BatchEvaluator::compileKernel(SymbolID Name) {
+    if (!Definitions.count(Name)) {
+        LogError("Batch evaluation needs a function definition");
+        return nullptr;
+    }
+    //generating the calls reads Protos, the optimizer uses the JIT's TargetMachine
+    std::lock_guard<std::mutex> Guard(JITLock);
+    CodegenContext CG("batch", &Protos);
+    CG.getModule().setDataLayout(JIT.getTargetMachine().createDataLayout());
+    CG.setFastMathFlags(FMF);
+    if (!emitDefinitions(CG, Name)) {
+        return nullptr;
+    }
+    Function *F = CG.getFunction(Name);
+
+    // void kernel(double **Columns, double *Out, i64 NumRows)
+    LLVMContext &Context = CG.getContext();
+    IRBuilder<> &Builder = CG.getBuilder();
+    Type *DoubleTy       = Builder.getDoubleTy();
+    Type *ColumnTy       = DoubleTy->getPointerTo();
+    Type *Int64Ty        = Builder.getInt64Ty();
+    Type *Params[]       = {ColumnTy->getPointerTo(), ColumnTy, Int64Ty};
+    FunctionType *KernelTy = FunctionType::get(Builder.getVoidTy(), Params, false);
+    std::string KernelName = "__batch." + std::to_string(NumKernels++);
+    Function *Kernel = Function::Create(KernelTy, Function::ExternalLinkage, KernelName, CG.getModule());
+    auto ArgIt       = Kernel->arg_begin();
+    Argument *Columns = &*ArgIt++;
+    Argument *Out     = &*ArgIt++;
+    Argument *NumRows = &*ArgIt;
+    //what lets the vectorizer skip the runtime overlap checks against Out
+    Out->addAttr(Attribute::NoAlias);
+    CG.addFPAttributes(*Kernel);
+
+    BasicBlock *Entry = BasicBlock::Create(Context, "entry", Kernel);
+    BasicBlock *Loop  = BasicBlock::Create(Context, "loop", Kernel);
+    BasicBlock *Exit  = BasicBlock::Create(Context, "exit", Kernel);
+
+    //the column pointers are loaded once, before the loop
+    Builder.SetInsertPoint(Entry);
+    std::vector<Value *> ColumnPtrs;
+    for (unsigned I = 0, E = F->arg_size(); I != E; ++I) {
+        Value *Slot = Builder.CreateInBoundsGEP(ColumnTy, Columns, Builder.getInt64(I));
+        ColumnPtrs.push_back(Builder.CreateAlignedLoad(ColumnTy, Slot, 8, "column"));
+    }
+    Builder.CreateCondBr(Builder.CreateICmpEQ(NumRows, Builder.getInt64(0)), Exit, Loop);
+
+    Builder.SetInsertPoint(Loop);
+    PHINode *Row = Builder.CreatePHI(Int64Ty, 2, "row");
+    Row->addIncoming(Builder.getInt64(0), Entry);
+    std::vector<Value *> Args;
+    for (Value *Column : ColumnPtrs) {
+        Value *Elt = Builder.CreateInBoundsGEP(DoubleTy, Column, Row);
+        Args.push_back(Builder.CreateAlignedLoad(DoubleTy, Elt, 8, "arg"));
+    }
+    Value *Result = Builder.CreateCall(F, Args, "result");
+    Builder.CreateAlignedStore(Result, Builder.CreateInBoundsGEP(DoubleTy, Out, Row), 8);
+    Value *NextRow = Builder.CreateAdd(Row, Builder.getInt64(1), "nextrow", true, true);
+    Row->addIncoming(NextRow, Loop);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(NextRow, NumRows), Exit, Loop);
+
+    Builder.SetInsertPoint(Exit);
+    Builder.CreateRetVoid();
+    verifyFunction(*Kernel);
+
+    TargetMachine &TM        = JIT.getTargetMachine();
+    optimizeModule(CG.getModule(), opt_O3, &TM);
+    CodeGenOpt::Level Level = TM.getOptLevel();
+    TM.setOptLevel(CodeGenOpt::Aggressive);
+    JIT.addModule(CG.takeModule());
+    TM.setOptLevel(Level);
+    auto Sym = JIT.findSymbol(KernelName);
+    return (BatchKernel)(intptr_t)cantFail(Sym.getAddress());
+}
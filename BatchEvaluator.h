@@ -0,0 +1,50 @@
+#ifndef __BATCHEVALUATOR_H__
+#define __BATCHEVALUATOR_H__
+//===----------------------------------------------------------------------===//
+// Evaluating a definition over columns of doubles
+//===----------------------------------------------------------------------===//
+// Calling a JIT-compiled function once per row through a pointer pays a call
+// for every element and leaves nothing to vectorize. A kernel is a loop over
+// the rows compiled together with a private copy of the function (and of the
+// definitions it calls), so -O3 inlines the body into the loop and the loop
+// vectorizer can turn it into SIMD code for the host.
+#include <mutex>
+#include "AllInclude.h"
+#include "Codegen.h"
+#include "FlatAST.h"
+#include "KaleidoscopeJIT.h"
+
+class FunctionAST;
+
+/// BatchKernel - Out[I] = F(Columns[0][I], ..., Columns[N - 1][I]) for every
+/// I < NumRows, where F takes N arguments. Out must not overlap the columns.
+typedef void (*BatchKernel)(const double *const *Columns, double *Out, uint64_t NumRows);
+
+/// BatchEvaluator - compiles kernels for the definitions handed to the JIT
+class BatchEvaluator {
+    orc::KaleidoscopeJIT &JIT;
+    //held around every use of the JIT and every change of Protos
+    std::mutex &JITLock;
+    const FunctionProtoMap &Protos;
+    const FastMathFlags FMF;
+    //the definitions by name, the kernels are generated from a flat copy
+    DenseMap<SymbolID, std::unique_ptr<FlatFunctionAST>> Definitions;
+    unsigned NumKernels;
+
+    bool emitDefinitions(CodegenContext &CG, SymbolID Name);
+
+   public:
+    //the kernels are generated with the fast-math flags FMF, like the definitions
+    BatchEvaluator(orc::KaleidoscopeJIT &JIT, std::mutex &JITLock, const FunctionProtoMap &Protos,
+                   FastMathFlags FMF)
+        : JIT(JIT), JITLock(JITLock), Protos(Protos), FMF(FMF), NumKernels(0) {}
+
+    /// addDefinition - keep a copy of FnAST, which the JIT has compiled
+    void addDefinition(const FunctionAST &FnAST);
+
+    /// compileKernel - JIT the kernel of the definition Name at -O3, null if
+    /// Name is not a definition added here. Takes JITLock.
+    BatchKernel compileKernel(SymbolID Name);
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include "Bytecode.h"
+#include "AST.h"
+#include "Error.h"
+#include "Interpreter.h"
+#include "ScopedSymbolTable.h"
+#include "llvm/Support/DynamicLibrary.h"
+
+//===----------------------------------------------------------------------===//
+// AST -> bytecode
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+//the bits of doubles that are small integers differ in the top bits only, which
+//DenseMap's hash of a uint64_t leaves there: fold them down, or every such
+//constant lands in the same bucket
+struct ConstBitsInfo : DenseMapInfo<uint64_t> {
+    static unsigned getHashValue(uint64_t Bits) { return DenseMapInfo<uint64_t>::getHashValue(Bits ^ (Bits >> 32)); }
+};
+
+/// FunctionCompiler - the bytecode of one function. Registers are handed out
+/// like a stack: an expression compiled with free registers from Top on leaves
+/// everything below Top alone, so a call's arguments can go to Top, Top + 1...
+/// The tree is compiled without recursion, from an explicit stack of the
+/// expressions under way, so any nesting depth the parser accepts is fine.
+class FunctionCompiler {
+    BytecodeVM &VM;
+    BytecodeFunction &Fn;
+    //the register of each variable, plus one (0 is unbound)
+    ScopedSymbolTable<unsigned> Variables;
+    DenseMap<uint64_t, unsigned, ConstBitsInfo> ConstIndex;
+
+    //Pending - an expression being computed into Dst, with the registers from
+    //Top on for temporaries. Next counts its parts done; Regs holds where its
+    //operands are and Jumps the instructions still to patch.
+    struct Pending {
+        const ExprAST *E;
+        unsigned Dst, Top;
+        unsigned Next;
+        unsigned Regs[2];
+        unsigned Jumps[2];
+    };
+    SmallVector<Pending, 32> Stack;
+
+    void emit(BytecodeOp Op, unsigned Dst, unsigned A, unsigned B) {
+        Fn.NumRegs = std::max(Fn.NumRegs, Dst + 1);
+        Instr I    = {Op, Dst, A, B};
+        Fn.Code.push_back(I);
+    }
+
+    unsigned getConst(double Val) {
+        uint64_t Bits;
+        memcpy(&Bits, &Val, sizeof(Bits));
+        auto Result = ConstIndex.insert(std::make_pair(Bits, (unsigned)Fn.Consts.size()));
+        if (Result.second) {
+            Fn.Consts.push_back(Val);
+        }
+        return Result.first->second;
+    }
+
+    /// here - the index of the next instruction, for jumps
+    unsigned here() const { return Fn.Code.size(); }
+
+    /// compileInto - have E computed into register Dst, using the registers
+    /// from Top on for temporaries
+    void compileInto(const ExprAST *E, unsigned Dst, unsigned Top) {
+        Pending P = {E, Dst, Top, 0, {0, 0}, {0, 0}};
+        Stack.push_back(P);
+    }
+
+    /// compileOperand - make the value of E available in a register, Reg. A
+    /// variable already is, anything else is computed into Top. Reg is set
+    /// right away, the code follows.
+    bool compileOperand(const ExprAST *E, unsigned Top, unsigned &Reg) {
+        if (auto *Var = dyn_cast<VariableExprAST>(E)) {
+            unsigned Bound = Variables.lookup(Var->getName());
+            if (!Bound) {
+                LogErrorV("Unkonw variable name");
+                return false;
+            }
+            Reg = Bound - 1;
+            return true;
+        }
+        Reg = Top;
+        compileInto(E, Top, Top);
+        return true;
+    }
+
+    /// compilePending - compile everything on Stack. Each step handles the
+    /// next part of the innermost expression, which may push an operand; P
+    /// is not used after a push, that may move it.
+    bool compilePending() {
+        while (!Stack.empty()) {
+            Pending &P = Stack.back();
+            bool Compiled = false;
+            switch (P.E->getKind()) {
+                case ExprAST::expr_number:
+                    emit(bc_const, P.Dst, getConst(cast<NumberExprAST>(P.E)->getVal()), 0);
+                    Stack.pop_back();
+                    continue;
+                case ExprAST::expr_variable: {
+                    unsigned Reg;
+                    if (!compileOperand(P.E, P.Top, Reg)) {
+                        return false;
+                    }
+                    emit(bc_mov, P.Dst, Reg, 0);
+                    Stack.pop_back();
+                    continue;
+                }
+                case ExprAST::expr_binary:
+                    Compiled = compileBinary(P);
+                    break;
+                case ExprAST::expr_call:
+                    Compiled = compileCall(P);
+                    break;
+                case ExprAST::expr_if:
+                    Compiled = compileIf(P);
+                    break;
+                case ExprAST::expr_for:
+                    Compiled = compileFor(P);
+                    break;
+            }
+            if (!Compiled) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// getBinaryOp - the instruction of a binary operator, false if there is none
+    static bool getBinaryOp(char Op, BytecodeOp &Result) {
+        switch (Op) {
+            case '+':
+                Result = bc_add;
+                return true;
+            case '-':
+                Result = bc_sub;
+                return true;
+            case '*':
+                Result = bc_mul;
+                return true;
+            case '<':
+                Result = bc_lt;
+                return true;
+        }
+        return false;
+    }
+
+    bool compileBinary(Pending &P) {
+        auto *Bin = cast<BinaryExprAST>(P.E);
+        BytecodeOp Op;
+        if (!getBinaryOp(Bin->getOp(), Op)) {
+            LogErrorV("invalid binary operator");
+            return false;
+        }
+        switch (P.Next++) {
+            case 0:
+                return compileOperand(Bin->getLHS(), P.Top, P.Regs[0]);
+            case 1:
+                return compileOperand(Bin->getRHS(), P.Regs[0] == P.Top ? P.Top + 1 : P.Top, P.Regs[1]);
+        }
+        emit(Op, P.Dst, P.Regs[0], P.Regs[1]);
+        Stack.pop_back();
+        return true;
+    }
+
+    bool compileIf(Pending &P) {
+        auto *If = cast<IfExprAST>(P.E);
+        switch (P.Next++) {
+            case 0:
+                return compileOperand(If->getCond(), P.Top, P.Regs[0]);
+            case 1:
+                P.Jumps[0] = here();
+                emit(bc_jump_if_not, 0, P.Regs[0], 0);
+                compileInto(If->getThen(), P.Dst, P.Top);
+                return true;
+            case 2:
+                P.Jumps[1] = here();
+                emit(bc_jump, 0, 0, 0);
+                Fn.Code[P.Jumps[0]].B = here();
+                compileInto(If->getElse(), P.Dst, P.Top);
+                return true;
+        }
+        Fn.Code[P.Jumps[1]].A = here();
+        Stack.pop_back();
+        return true;
+    }
+
+    /// compileFor - the loop codegen emits: an integer counter k, up to a trip
+    /// count computed once, and the loop variable Start + k * Step
+    bool compileFor(Pending &P) {
+        auto *For    = cast<ForExprAST>(P.E);
+        unsigned Top = P.Top;
+        unsigned Start = Top, Step = Top + 2, Count = Top + 3, K = Top + 4, Sum = Top + 5, Var = Top + 6;
+        unsigned BodyTop = Top + 7;
+        switch (P.Next++) {
+            case 0:
+                compileInto(For->getStart(), Start, Top + 3);
+                return true;
+            case 1:
+                compileInto(For->getEnd(), Top + 1, Top + 3);
+                return true;
+            case 2:
+                compileInto(For->getStep(), Step, Top + 3);
+                return true;
+            case 3:
+                emit(bc_trip_count, Count, Start, 0);
+                emit(bc_const, Sum, getConst(0.0), 0);
+                P.Jumps[0] = here();
+                emit(bc_for_begin, K, Count, 0);
+                P.Jumps[1] = here();
+                emit(bc_for_var, Var, Start, K);
+                //the loop variable shadows an argument of the same name inside
+                //the body. After an error the scope stays open, but the
+                //compiler is thrown away then
+                Variables.pushScope();
+                Variables.bind(For->getVarName(), Var + 1);
+                return compileOperand(For->getBody(), BodyTop, P.Regs[0]);
+        }
+        Variables.popScope();
+        emit(bc_add, Sum, Sum, P.Regs[0]);
+        emit(bc_for_next, K, Count, P.Jumps[1]);
+        Fn.Code[P.Jumps[0]].B = here();
+        emit(bc_mov, P.Dst, Sum, 0);
+        Stack.pop_back();
+        return true;
+    }
+
+    bool compileCall(Pending &P) {
+        auto *Call               = cast<CallExprAST>(P.E);
+        ArrayRef<ExprAST *> Args = Call->getArgs();
+        BytecodeFunction *Callee = VM.getFunction(Call->getCallee());
+        if (0 == P.Next) {
+            if (!Callee) {
+                LogErrorV("UnKonwn function referenced");
+                return false;
+            }
+            if (Callee->NumArgs != Args.size()) {
+                LogErrorV("Incorrect # arguments passed");
+                return false;
+            }
+            if (Callee->Host && Args.size() > MaxInterpretedArgs) {
+                LogErrorV("Too many arguments for an extern called by the VM");
+                return false;
+            }
+        }
+        //each argument in its own register from Top on, the callee's frame starts there
+        if (P.Next != Args.size()) {
+            unsigned I = P.Next++;
+            compileInto(Args[I], P.Top + I, P.Top + I + 1);
+            return true;
+        }
+        //calls of an extern the process has go to it, unless a definition took its place
+        bool Extern = Callee->Host && !Callee->isDefined();
+        emit(Extern ? bc_call_extern : bc_call, P.Dst, VM.getFunctionIndex(Call->getCallee()), P.Top);
+        Stack.pop_back();
+        return true;
+    }
+
+   public:
+    FunctionCompiler(BytecodeVM &VM, BytecodeFunction &Fn) : VM(VM), Fn(Fn) {}
+
+    bool compileBody(const FunctionAST &FnAST) {
+        ScopedSymbolTable<unsigned>::Scope ArgScope(Variables);
+        const PrototypeAST &Proto = FnAST.getProto();
+        for (unsigned I = 0, E = Proto.getNumArgs(); I != E; ++I) {
+            Variables.bind(Proto.getArg(I), I + 1);
+        }
+        unsigned Reg;
+        if (!compileOperand(FnAST.getBody(), Fn.NumArgs, Reg) || !compilePending()) {
+            return false;
+        }
+        emit(bc_ret, 0, Reg, 0);
+        return true;
+    }
+};
+
+}  // end anonymous namespace
+
+BytecodeVM::BytecodeVM(size_t StackSize) : Stack(new double[StackSize]), StackSize(StackSize) {
+    //externs are looked up in the process, as the JIT does
+    sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+}
+
+bool BytecodeVM::compile(const FunctionAST &FnAST, BytecodeFunction &Fn) {
+    return FunctionCompiler(*this, Fn).compileBody(FnAST);
+}
+
+bool BytecodeVM::addExtern(const PrototypeAST &Proto) {
+    //like FunctionTable, the first prototype of a name stays
+    if (FunctionIndex.count(Proto.getName())) {
+        return true;
+    }
+    FunctionIndex[Proto.getName()] = Functions.size();
+    Functions.push_back(llvm::make_unique<BytecodeFunction>(Proto.getName(), Proto.getNumArgs()));
+    Functions.back()->IsExtern = true;
+    Functions.back()->Host     = sys::DynamicLibrary::SearchForAddressOfSymbol(getSymbolName(Proto.getName()).str());
+    return true;
+}
+
+bool BytecodeVM::addDefinition(const FunctionAST &FnAST) {
+    const PrototypeAST &Proto = FnAST.getProto();
+    BytecodeFunction *Fn      = getFunction(Proto.getName());
+    if (Fn && Fn->isDefined()) {
+        LogErrorV("Function cannot be redefined.");
+        return false;
+    }
+    if (Fn && Fn->NumArgs != Proto.getNumArgs()) {
+        LogErrorV("Definition does not match the # arguments of its extern");
+        return false;
+    }
+    bool Declared = Fn != nullptr;
+    if (!Fn) {
+        //declared before the body is compiled, so the body can call itself
+        FunctionIndex[Proto.getName()] = Functions.size();
+        Functions.push_back(llvm::make_unique<BytecodeFunction>(Proto.getName(), Proto.getNumArgs()));
+        Fn = Functions.back().get();
+    }
+    if (compile(FnAST, *Fn)) {
+        return true;
+    }
+    //error reading body, forget the function unless an extern declared it
+    Fn->Code.clear();
+    Fn->Consts.clear();
+    Fn->NumRegs = Fn->NumArgs;
+    if (!Declared) {
+        FunctionIndex.erase(Proto.getName());
+    }
+    return false;
+}
+
+bool BytecodeVM::evaluate(const FunctionAST &FnAST, double &Result) {
+    BytecodeFunction Fn(sym_anon, 0);
+    return compile(FnAST, Fn) && run(Fn, Result);
+}
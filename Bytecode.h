@@ -0,0 +1,93 @@
+#ifndef __BYTECODE_H__
+#define __BYTECODE_H__
+//===----------------------------------------------------------------------===//
+// Register bytecode and the VM that runs it
+//===----------------------------------------------------------------------===//
+// An engine next to the JIT that starts instantly: a definition goes from the
+// AST to bytecode in one walk and runs without any of LLVM's code generation.
+// Every function has a frame of double registers with its arguments in the
+// first ones. The arguments of a call are evaluated into consecutive registers
+// at the top of the caller's frame, and those become the bottom of the
+// callee's frame, so a call copies nothing. The counters of for loops are
+// 64-bit integers kept in the bits of a register.
+#include "AllInclude.h"
+#include "Symbol.h"
+#include "llvm/ADT/DenseMap.h"
+
+class FunctionAST;
+class PrototypeAST;
+
+enum BytecodeOp : uint32_t {
+    bc_const,        // R[Dst] = Consts[A]
+    bc_mov,          // R[Dst] = R[A]
+    bc_add,          // R[Dst] = R[A] + R[B]
+    bc_sub,          // R[Dst] = R[A] - R[B]
+    bc_mul,          // R[Dst] = R[A] * R[B]
+    bc_lt,           // R[Dst] = R[A] < R[B] or unordered ? 1.0 : 0.0
+    bc_trip_count,   // R[Dst] = the iterations of a for from R[A], to R[A + 1], by R[A + 2], an integer
+    bc_for_begin,    // R[Dst] = integer 0, continue at Code[B] if the integer R[A] is 0
+    bc_for_var,      // R[Dst] = R[A] + R[B] * R[A + 2], R[B] is an integer
+    bc_for_next,     // ++R[Dst] (an integer), continue at Code[B] if it is below the integer R[A]
+    bc_jump,         // continue at Code[A]
+    bc_jump_if_not,  // continue at Code[B] if R[A] is 0 or NaN
+    bc_call,         // R[Dst] = Functions[A](R[B], ...), its frame starts at R[B]
+    bc_call_extern,  // R[Dst] = the host function of Functions[A](R[B], ...)
+    bc_ret,          // return R[A]
+};
+
+struct Instr {
+    uint32_t Op;
+    uint32_t Dst;
+    uint32_t A;
+    uint32_t B;
+};
+
+struct BytecodeFunction {
+    SymbolID Name;
+    unsigned NumArgs;
+    //the frame size
+    unsigned NumRegs;
+    std::vector<Instr> Code;
+    std::vector<double> Consts;
+    //what an extern resolved to in this process, null for a bytecode function
+    void *Host;
+    //declared by an extern, kept even if a definition of it fails
+    bool IsExtern;
+
+    BytecodeFunction(SymbolID Name, unsigned NumArgs)
+        : Name(Name), NumArgs(NumArgs), NumRegs(NumArgs), Host(nullptr), IsExtern(false) {}
+    bool isDefined() const { return !Code.empty(); }
+};
+
+/// BytecodeVM - the functions of a program as bytecode, and the interpreter
+/// loop running them. Errors are reported with the same messages codegen uses.
+class BytecodeVM {
+    //indices into Functions are in the code, the functions never move
+    std::vector<std::unique_ptr<BytecodeFunction>> Functions;
+    DenseMap<SymbolID, unsigned> FunctionIndex;
+    //the registers of all frames
+    std::unique_ptr<double[]> Stack;
+    size_t StackSize;
+
+    bool compile(const FunctionAST &FnAST, BytecodeFunction &Fn);
+    bool run(const BytecodeFunction &Entry, double &Result);
+
+   public:
+    explicit BytecodeVM(size_t StackSize = 1 << 20);
+
+    BytecodeFunction *getFunction(SymbolID Name) {
+        auto It = FunctionIndex.find(Name);
+        return It == FunctionIndex.end() ? nullptr : Functions[It->second].get();
+    }
+    unsigned getFunctionIndex(SymbolID Name) const { return FunctionIndex.lookup(Name); }
+
+    /// addExtern - declare Proto. It is called in this process if the process
+    /// has a function of that name, as bytecode if a definition follows.
+    bool addExtern(const PrototypeAST &Proto);
+    /// addDefinition - compile FnAST to bytecode
+    bool addDefinition(const FunctionAST &FnAST);
+    /// evaluate - compile and run the top-level expression FnAST
+    bool evaluate(const FunctionAST &FnAST, double &Result);
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "Bytecode.h"
+#include "Error.h"
+#include "Interpreter.h"
+#include "llvm/Support/MathExtras.h"
+
+//===----------------------------------------------------------------------===//
+// Bytecode interpreter loop
+//===----------------------------------------------------------------------===//
+// With GCC and clang every handler ends in its own indirect jump through a
+// label table (computed goto), so the branch predictor sees one dispatch site
+// per opcode instead of the single one of a switch. Other compilers get the
+// switch.
+
+#if defined(__GNUC__)
+#define VM_THREADED 1
+#endif
+
+#ifdef VM_THREADED
+#define VM_DISPATCH() goto *Labels[PC->Op];
+#define VM_CASE(Name) op_##Name:
+#define VM_NEXT() goto *Labels[PC->Op]
+#else
+#define VM_DISPATCH() \
+    for (;;)          \
+        switch (PC->Op)
+#define VM_CASE(Name) case bc_##Name:
+#define VM_NEXT() continue
+#endif
+
+namespace {
+
+//recursion deeper than this is reported instead of growing the frames further
+const size_t MaxCallDepth = 1 << 18;
+
+/// isTrue - a condition holds when it is neither 0 nor NaN, fcmp one
+inline bool isTrue(double Cond) {
+    return Cond < 0.0 || Cond > 0.0;
+}
+
+struct Frame {
+    const BytecodeFunction *Fn;
+    const Instr *ReturnPC;
+    double *Base;
+    uint32_t Dst;
+};
+
+}  // end anonymous namespace
+
+bool BytecodeVM::run(const BytecodeFunction &Entry, double &Result) {
+    if (Entry.NumRegs > StackSize) {
+        LogErrorV("VM stack overflow");
+        return false;
+    }
+    std::vector<Frame> Frames;
+    const BytecodeFunction *Fn = &Entry;
+    const Instr *Code          = Fn->Code.data();
+    const Instr *PC            = Code;
+    const double *K            = Fn->Consts.data();
+    double *R                  = Stack.get();
+    double *StackEnd           = Stack.get() + StackSize;
+
+#ifdef VM_THREADED
+    //in BytecodeOp order
+    static void *const Labels[] = {&&op_const,     &&op_mov,         &&op_add,         &&op_sub,
+                                   &&op_mul,       &&op_lt,          &&op_trip_count,  &&op_for_begin,
+                                   &&op_for_var,   &&op_for_next,    &&op_jump,        &&op_jump_if_not,
+                                   &&op_call,      &&op_call_extern, &&op_ret};
+#endif
+
+    VM_DISPATCH() {
+        VM_CASE(const) {
+            R[PC->Dst] = K[PC->A];
+            ++PC;
+            VM_NEXT();
+        }
+        VM_CASE(mov) {
+            R[PC->Dst] = R[PC->A];
+            ++PC;
+            VM_NEXT();
+        }
+        VM_CASE(add) {
+            R[PC->Dst] = R[PC->A] + R[PC->B];
+            ++PC;
+            VM_NEXT();
+        }
+        VM_CASE(sub) {
+            R[PC->Dst] = R[PC->A] - R[PC->B];
+            ++PC;
+            VM_NEXT();
+        }
+        VM_CASE(mul) {
+            R[PC->Dst] = R[PC->A] * R[PC->B];
+            ++PC;
+            VM_NEXT();
+        }
+        VM_CASE(lt) {
+            //unordered is true, like the fcmp ult codegen emits
+            R[PC->Dst] = !(R[PC->A] >= R[PC->B]) ? 1.0 : 0.0;
+            ++PC;
+            VM_NEXT();
+        }
+        VM_CASE(trip_count) {
+            R[PC->Dst] = BitsToDouble(getTripCount(R[PC->A], R[PC->A + 1], R[PC->A + 2]));
+            ++PC;
+            VM_NEXT();
+        }
+        VM_CASE(for_begin) {
+            R[PC->Dst] = BitsToDouble(0);
+            PC         = DoubleToBits(R[PC->A]) ? PC + 1 : Code + PC->B;
+            VM_NEXT();
+        }
+        VM_CASE(for_var) {
+            R[PC->Dst] = R[PC->A] + (double)DoubleToBits(R[PC->B]) * R[PC->A + 2];
+            ++PC;
+            VM_NEXT();
+        }
+        VM_CASE(for_next) {
+            uint64_t Next = DoubleToBits(R[PC->Dst]) + 1;
+            R[PC->Dst]    = BitsToDouble(Next);
+            PC            = Next < DoubleToBits(R[PC->A]) ? Code + PC->B : PC + 1;
+            VM_NEXT();
+        }
+        VM_CASE(jump) {
+            PC = Code + PC->A;
+            VM_NEXT();
+        }
+        VM_CASE(jump_if_not) {
+            PC = isTrue(R[PC->A]) ? PC + 1 : Code + PC->B;
+            VM_NEXT();
+        }
+        VM_CASE(call) {
+            const BytecodeFunction *Callee = Functions[PC->A].get();
+            if (!Callee->isDefined()) {
+                LogErrorV("UnKonwn function referenced");
+                return false;
+            }
+            double *Base = R + PC->B;
+            if (Callee->NumRegs > (size_t)(StackEnd - Base) || Frames.size() == MaxCallDepth) {
+                LogErrorV("VM stack overflow");
+                return false;
+            }
+            Frame Caller = {Fn, PC + 1, R, PC->Dst};
+            Frames.push_back(Caller);
+            Fn   = Callee;
+            Code = Fn->Code.data();
+            PC   = Code;
+            K    = Fn->Consts.data();
+            R    = Base;
+            VM_NEXT();
+        }
+        VM_CASE(call_extern) {
+            const BytecodeFunction *Callee = Functions[PC->A].get();
+            R[PC->Dst] = callNative(Callee->Host, makeArrayRef(R + PC->B, Callee->NumArgs));
+            ++PC;
+            VM_NEXT();
+        }
+        VM_CASE(ret) {
+            double Val = R[PC->A];
+            if (Frames.empty()) {
+                Result = Val;
+                return true;
+            }
+            const Frame &Caller = Frames.back();
+            Fn                  = Caller.Fn;
+            Code                = Fn->Code.data();
+            PC                  = Caller.ReturnPC;
+            K                   = Fn->Consts.data();
+            R                   = Caller.Base;
+            R[Caller.Dst]       = Val;
+            Frames.pop_back();
+            VM_NEXT();
+        }
+#ifndef VM_THREADED
+        default:
+            llvm_unreachable("unknown bytecode op");
+#endif
+    }
+}
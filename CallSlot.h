@@ -0,0 +1,60 @@
+#ifndef __CALLSLOT_H__
+#define __CALLSLOT_H__
+#include <atomic>
+#include <mutex>
+#include "AllInclude.h"
+#include "Symbol.h"
+#include "llvm/ADT/DenseMap.h"
+//===----------------------------------------------------------------------===//
+// Call slots of the tiered JIT
+//===----------------------------------------------------------------------===//
+
+/// CallSlot - the indirection in front of a function whose code is replaced
+/// while the program runs. Generated calls load the callee from Address, so
+/// storing a new address redirects every later call. Baseline code counts its
+/// entries in Entries. Generated code reads both fields as a plain pointer and
+/// a uint64_t.
+struct CallSlot {
+    std::atomic<void *> Address;
+    std::atomic<uint64_t> Entries;
+    SymbolID Name;
+
+    explicit CallSlot(SymbolID Name) : Address(nullptr), Entries(0), Name(Name) {}
+};
+
+/// CallSlotTable - the slots by function name. Thread safe, a slot never moves
+/// or goes away once created.
+class CallSlotTable {
+    std::mutex Lock;
+    DenseMap<SymbolID, std::unique_ptr<CallSlot>> Slots;
+
+   public:
+    CallSlot *lookup(SymbolID Name) {
+        std::lock_guard<std::mutex> Guard(Lock);
+        auto It = Slots.find(Name);
+        return It == Slots.end() ? nullptr : It->second.get();
+    }
+
+    CallSlot *getOrCreate(SymbolID Name) {
+        std::lock_guard<std::mutex> Guard(Lock);
+        std::unique_ptr<CallSlot> &Slot = Slots[Name];
+        if (!Slot) {
+            Slot = llvm::make_unique<CallSlot>(Name);
+        }
+        return Slot.get();
+    }
+};
+
+/// TierUpFn - called by baseline code when the entry count of its function
+/// reaches the threshold
+typedef void (*TierUpFn)(void *Context, CallSlot *Slot);
+
+/// EntryCounting - how baseline code counts its entries, TierUp(Context, Slot)
+/// is called when the count reaches Threshold
+struct EntryCounting {
+    TierUpFn TierUp;
+    void *Context;
+    uint64_t Threshold;
+};
+
+#endif
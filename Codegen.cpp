@@ -1,14 +1,105 @@
 #include "Codegen.h"
 #include "AST.h"
 #include "Error.h"
+#include "Memoize.h"
+
+CodegenContext::CodegenContext(StringRef ModuleName, const FunctionProtoMap *FunctionProtos)
+    : Context(llvm::make_unique<LLVMContext>()),
+      TheModule(llvm::make_unique<Module>(ModuleName, *Context)),
+      Builder(*Context),
+      FPM(llvm::make_unique<legacy::FunctionPassManager>(TheModule.get())),
+      FPMInitialized(false),
+      FunctionProtos(FunctionProtos),
+      CallSlots(nullptr),
+      Counting(),
+      Memo(nullptr) {}
+
+Function *CodegenContext::getFunction(SymbolID Name) {
+    if (Function *F = FunctionTable.lookup(Name)) {
+        return F;
+    }
+    //defined in another module, declare it in this one
+    if (FunctionProtos) {
+        auto It = FunctionProtos->find(Name);
+        if (It != FunctionProtos->end()) {
+            return It->second->codegen(*this);
+        }
+    }
+    return nullptr;
+}
+
+std::unique_ptr<Module> CodegenContext::takeModule() {
+    if (FPMInitialized) {
+        FPM->doFinalization();
+        FPMInitialized = false;
+    }
+    std::unique_ptr<Module> Old = std::move(TheModule);
+    TheModule = llvm::make_unique<Module>(Old->getModuleIdentifier(), *Context);
+    TheModule->setDataLayout(Old->getDataLayout());
+    FPM = llvm::make_unique<legacy::FunctionPassManager>(TheModule.get());
+    FunctionTable.clear();
+    return Old;
+}
+
+void CodegenContext::runFunctionPasses(Function &F) {
+    //passes may still be added until the first function is done
+    if (!FPMInitialized) {
+        FPM->doInitialization();
+        FPMInitialized = true;
+    }
+    FPM->run(F);
+}
+
+void CodegenContext::addFPAttributes(Function &F) {
+    FastMathFlags FMF = Builder.getFastMathFlags();
+    if (FMF.isFast()) {
+        F.addFnAttr("unsafe-fp-math", "true");
+    }
+    if (FMF.noInfs()) {
+        F.addFnAttr("no-infs-fp-math", "true");
+    }
+    if (FMF.noNaNs()) {
+        F.addFnAttr("no-nans-fp-math", "true");
+    }
+    if (FMF.noSignedZeros()) {
+        F.addFnAttr("no-signed-zeros-fp-math", "true");
+    }
+}
+
+void CodegenContext::removeFunction(Function *F) {
+    auto It = FunctionTable.find(internSymbol(F->getName()));
+    if (It != FunctionTable.end() && It->second == F) {
+        FunctionTable.erase(It);
+    }
+    F->eraseFromParent();
+}
+
+Value *ExprAST::codegen(CodegenContext &CG) {
+    switch (Kind) {
+        case expr_number:
+            return cast<NumberExprAST>(this)->codegen(CG);
+        case expr_variable:
+            return cast<VariableExprAST>(this)->codegen(CG);
+        case expr_binary:
+            return cast<BinaryExprAST>(this)->codegen(CG);
+        case expr_call:
+            return cast<CallExprAST>(this)->codegen(CG);
+        case expr_if:
+            return cast<IfExprAST>(this)->codegen(CG);
+        case expr_for:
+            return cast<ForExprAST>(this)->codegen(CG);
+    }
+    llvm_unreachable("unknown expression kind");
+}
+
 /// In the LLVM IR, numeric constants are represented with the ConstantFP class, Note that in the LLVM IR that constants are all uniqued together and shared. For this reason, the API uses the “foo::get(…)” idiom instead of “new foo(..)” or “foo::Create(..)”.
-Value *NumberExprAST::codegen() {
-    return ConstantFP::get(TheContext, APFloat(Val));
+Value *NumberExprAST::codegen(CodegenContext &CG) {
+    return ConstantFP::get(CG.getContext(), APFloat(Val));
 }
 
-Value *VariableExprAST::codegen() {
+Value *VariableExprAST::codegen(CodegenContext &CG) {
     // look this variable up in the function
-    Value *V = NamedValues[Name];
+    Value *V = CG.NamedValues.lookup(Name);
     if (!V) {
         LogErrorV("Unkonw variable name");
     }
@@ -16,14 +107,9 @@ Value *VariableExprAST::codegen() {
     return V;
 }
 
-Value *BinaryExprAST::codegen() {
-    Value *L = LHS->codegen();
-    Value *R = RHS->codegen();
-
-    if (!L || !R) {
-        return nullptr;
-    }
-
+/// emitBinary - the IR for one binary operator, shared by both AST forms
+static Value *emitBinary(CodegenContext &CG, char Op, Value *L, Value *R) {
+    IRBuilder<> &Builder = CG.getBuilder();
     switch (Op) {
         case '+':
             return Builder.CreateFAdd(L, R, "addtmp");
@@ -34,54 +120,301 @@ Value *BinaryExprAST::codegen() {
         case '<':
             L = Builder.CreateFCmpULT(L, R, "cmptmp");
             // Covert bool 0/1 to dlouble 0.0 or 1.0
-            return Builder.CreateUIToFP(L, Type::getDoubleTy(TheContext), "booltmp");
+            return Builder.CreateUIToFP(L, Type::getDoubleTy(CG.getContext()), "booltmp");
         default:
             return LogErrorV("invalid binary operator");
     }
 }
 
-Value *CallExprAST::codegen() {
-    //look up the name in the global module table
-    Function *CalleeF = TheModule->getFunction(Callee);
+/// hostPointer - a constant Ty* pointing at Addr in this process, for code
+/// that only runs in the JIT
+static Constant *hostPointer(CodegenContext &CG, const volatile void *Addr, Type *Ty) {
+    Constant *Int = ConstantInt::get(Type::getInt64Ty(CG.getContext()), (uint64_t)(uintptr_t)Addr);
+    return ConstantExpr::getIntToPtr(Int, PointerType::getUnqual(Ty));
+}
+
+/// emitCall - a call of Callee, the arguments are generated by EmitArg(i)
+static Value *emitCall(CodegenContext &CG, SymbolID Callee, size_t NumArgs, function_ref<Value *(size_t)> EmitArg) {
+    //look up the name in the module table, or declare it from its prototype
+    Function *CalleeF = CG.getFunction(Callee);
     if (!CalleeF) {
         return LogErrorV("UnKonwn function referenced");
     }
 
     // If arguement mismatch error
-    if (CalleeF->arg_size() != Args.size()) {
+    if (CalleeF->arg_size() != NumArgs) {
         return LogErrorV("Incorrect # arguments passed");
     }
 
     std::vector<Value *> ArgsV;
-    for (unsigned i = 0, e = Args.size(); i != e; i++) {
-        ArgsV.push_back(Args[i]->codegen());
+    for (size_t i = 0; i != NumArgs; i++) {
+        ArgsV.push_back(EmitArg(i));
         if (!ArgsV.back()) {
             return nullptr;
         }
     }
 
-    return Builder.CreateCall(CalleeF, ArgsV, "calltmp");
+    //a function of the tiered JIT is called through its slot, its code may be replaced
+    CallSlot *Slot = CG.getCallSlots() ? CG.getCallSlots()->lookup(Callee) : nullptr;
+    if (Slot && Slot->Address.load()) {
+        IRBuilder<> &Builder  = CG.getBuilder();
+        PointerType *FnPtrTy  = CalleeF->getFunctionType()->getPointerTo();
+        LoadInst *Target      = Builder.CreateAlignedLoad(FnPtrTy, hostPointer(CG, &Slot->Address, FnPtrTy), 8, "callee");
+        Target->setAtomic(AtomicOrdering::Acquire);
+        return Builder.CreateCall(CalleeF->getFunctionType(), Target, ArgsV, "calltmp");
+    }
+    return CG.getBuilder().CreateCall(CalleeF, ArgsV, "calltmp");
+}
+
+Value *BinaryExprAST::codegen(CodegenContext &CG) {
+    Value *L = getLHS()->codegen(CG);
+    Value *R = getRHS()->codegen(CG);
+
+    if (!L || !R) {
+        return nullptr;
+    }
+
+    return emitBinary(CG, Op, L, R);
+}
+
+Value *CallExprAST::codegen(CodegenContext &CG) {
+    return emitCall(CG, Callee, Args.size(), [&](size_t i) { return Args[i]->codegen(CG); });
+}
+
+/// emitIf - if/then/else as a diamond joined by a phi, which SimplifyCFG turns
+/// into a select when both sides are cheap
+static Value *emitIf(CodegenContext &CG, function_ref<Value *()> EmitCond, function_ref<Value *()> EmitThen,
+                     function_ref<Value *()> EmitElse) {
+    IRBuilder<> &Builder = CG.getBuilder();
+    Value *CondV         = EmitCond();
+    if (!CondV) {
+        return nullptr;
+    }
+    //true unless 0 or NaN
+    CondV = Builder.CreateFCmpONE(CondV, ConstantFP::get(CG.getContext(), APFloat(0.0)), "ifcond");
+
+    Function *TheFunction = Builder.GetInsertBlock()->getParent();
+    BasicBlock *ThenBB    = BasicBlock::Create(CG.getContext(), "then", TheFunction);
+    BasicBlock *ElseBB    = BasicBlock::Create(CG.getContext(), "else", TheFunction);
+    BasicBlock *MergeBB   = BasicBlock::Create(CG.getContext(), "ifcont", TheFunction);
+    Builder.CreateCondBr(CondV, ThenBB, ElseBB);
+
+    //a branch may end in another block than it started, the phi takes the last one
+    Builder.SetInsertPoint(ThenBB);
+    Value *ThenV = EmitThen();
+    if (!ThenV) {
+        return nullptr;
+    }
+    Builder.CreateBr(MergeBB);
+    ThenBB = Builder.GetInsertBlock();
+
+    Builder.SetInsertPoint(ElseBB);
+    Value *ElseV = EmitElse();
+    if (!ElseV) {
+        return nullptr;
+    }
+    Builder.CreateBr(MergeBB);
+    ElseBB = Builder.GetInsertBlock();
+
+    Builder.SetInsertPoint(MergeBB);
+    PHINode *PN = Builder.CreatePHI(Builder.getDoubleTy(), 2, "iftmp");
+    PN->addIncoming(ThenV, ThenBB);
+    PN->addIncoming(ElseV, ElseBB);
+    return PN;
+}
+
+/// emitFor - a counted loop in the form the loop passes expect: the trip
+/// count is computed once in a guard, the loop has a preheader, a single latch
+/// and a dedicated exit, and is driven by an integer induction variable in a
+/// phi. The loop variable is derived from it (Start + k * Step) rather than
+/// accumulated, so SCEV knows the trip count and the vectorizer can widen the
+/// body; the sum is a reduction phi, vectorized with -fp-mode=fast.
+static Value *emitFor(CodegenContext &CG, SymbolID VarName, function_ref<Value *()> EmitStart,
+                      function_ref<Value *()> EmitEnd, function_ref<Value *()> EmitStep,
+                      function_ref<Value *()> EmitBody) {
+    IRBuilder<> &Builder = CG.getBuilder();
+    Value *StartV        = EmitStart();
+    Value *EndV          = StartV ? EmitEnd() : nullptr;
+    Value *StepV         = EndV ? EmitStep() : nullptr;
+    if (!StepV) {
+        return nullptr;
+    }
+    Type *DoubleTy = Builder.getDoubleTy();
+    Type *Int64Ty  = Builder.getInt64Ty();
+    Constant *Zero = ConstantFP::get(DoubleTy, 0.0);
+
+    //ceil((End - Start) / Step) iterations when that is positive (not NaN), at most 2^63
+    Value *Span   = Builder.CreateFSub(EndV, StartV, "span");
+    Value *Steps  = Builder.CreateFDiv(Span, StepV, "steps");
+    Value *Ceil   = Builder.CreateUnaryIntrinsic(Intrinsic::ceil, Steps, nullptr, "steps");
+    Constant *Max = ConstantFP::get(DoubleTy, 9223372036854775808.0);
+    Value *Capped = Builder.CreateSelect(Builder.CreateFCmpOLT(Ceil, Max), Ceil, Max);
+    Value *Count  = Builder.CreateSelect(Builder.CreateFCmpOGT(Ceil, Zero),
+                                        Builder.CreateFPToUI(Capped, Int64Ty), Builder.getInt64(0), "tripcount");
+
+    Function *TheFunction   = Builder.GetInsertBlock()->getParent();
+    BasicBlock *GuardBB     = Builder.GetInsertBlock();
+    BasicBlock *PreheaderBB = BasicBlock::Create(CG.getContext(), "loop.ph", TheFunction);
+    BasicBlock *LoopBB      = BasicBlock::Create(CG.getContext(), "loop", TheFunction);
+    BasicBlock *ExitBB      = BasicBlock::Create(CG.getContext(), "loop.exit", TheFunction);
+    BasicBlock *EndBB       = BasicBlock::Create(CG.getContext(), "loop.end", TheFunction);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(Count, Builder.getInt64(0)), EndBB, PreheaderBB);
+    Builder.SetInsertPoint(PreheaderBB);
+    Builder.CreateBr(LoopBB);
+
+    Builder.SetInsertPoint(LoopBB);
+    PHINode *Index = Builder.CreatePHI(Int64Ty, 2, "k");
+    Index->addIncoming(Builder.getInt64(0), PreheaderBB);
+    PHINode *Sum = Builder.CreatePHI(DoubleTy, 2, "sum");
+    Sum->addIncoming(Zero, PreheaderBB);
+    Value *Var = Builder.CreateFAdd(Builder.CreateFMul(Builder.CreateUIToFP(Index, DoubleTy), StepV), StartV,
+                                    getSymbolName(VarName));
+
+    Value *BodyV;
+    {
+        //the loop variable shadows an argument of the same name inside the body
+        ScopedSymbolTable<Value *>::Scope LoopScope(CG.NamedValues);
+        CG.NamedValues.bind(VarName, Var);
+        BodyV = EmitBody();
+    }
+    if (!BodyV) {
+        return nullptr;
+    }
+    //the body may have branched, the latch is where it ended
+    BasicBlock *LatchBB = Builder.GetInsertBlock();
+    Value *NextSum      = Builder.CreateFAdd(Sum, BodyV, "sum.next");
+    //k goes up to the count, which may be 2^63: no signed wrap does not hold
+    Value *NextIndex    = Builder.CreateNUWAdd(Index, Builder.getInt64(1), "k.next");
+    Builder.CreateCondBr(Builder.CreateICmpEQ(NextIndex, Count), ExitBB, LoopBB);
+    Index->addIncoming(NextIndex, LatchBB);
+    Sum->addIncoming(NextSum, LatchBB);
+
+    Builder.SetInsertPoint(ExitBB);
+    Builder.CreateBr(EndBB);
+    Builder.SetInsertPoint(EndBB);
+    PHINode *Result = Builder.CreatePHI(DoubleTy, 2, "loopsum");
+    Result->addIncoming(Zero, GuardBB);
+    Result->addIncoming(NextSum, ExitBB);
+    return Result;
 }
 
-Function *PrototypeAST::codegen() {
+Value *IfExprAST::codegen(CodegenContext &CG) {
+    return emitIf(CG, [&]() { return getCond()->codegen(CG); }, [&]() { return getThen()->codegen(CG); },
+                  [&]() { return getElse()->codegen(CG); });
+}
+
+Value *ForExprAST::codegen(CodegenContext &CG) {
+    return emitFor(CG, VarName, [&]() { return getStart()->codegen(CG); }, [&]() { return getEnd()->codegen(CG); },
+                   [&]() { return getStep()->codegen(CG); }, [&]() { return getBody()->codegen(CG); });
+}
+
+Function *PrototypeAST::codegen(CodegenContext &CG) {
     //Make the function type double (double, double) etc
-    std::vector<Type *> Doubles(Args.size(), Type::getDoubleTy(TheContext));
-    FunctionType *FT = FunctionType::get(Type::getDoubleTy(TheContext), Doubles, false);
-    Function *F      = Function::Create(FT, Function::ExternalLinkage, Name, TheModule.get());
+    std::vector<Type *> Doubles(Args.size(), Type::getDoubleTy(CG.getContext()));
+    FunctionType *FT = FunctionType::get(Type::getDoubleTy(CG.getContext()), Doubles, false);
+    Function *F      = Function::Create(FT, Function::ExternalLinkage, getSymbolName(Name), &CG.getModule());
     // set names for all arguments
     unsigned Idx = 0;
     for (auto &Arg : F->args()) {
-        Arg.setName(Args[Idx++]);
+        Arg.setName(getSymbolName(Args[Idx++]));
+    }
+    //a second prototype of the same name gets renamed by the module, keep finding the first.
+    //top-level expressions are never looked up, each one gets a function of its own
+    if (sym_anon != Name) {
+        CG.FunctionTable.insert(std::make_pair(Name, F));
     }
 
     return F;
 }
 
-Function *FunctionAST::codegen() {
+/// emitEntryCounter - count the entries of F in its call slot and call the
+/// tier-up hook when the count reaches the threshold. Leaves the builder in
+/// the block the body goes into.
+static void emitEntryCounter(CodegenContext &CG, Function *F, SymbolID Name) {
+    const EntryCounting &Counting = CG.getEntryCounting();
+    CallSlot *Slot                = CG.getCallSlots()->getOrCreate(Name);
+    IRBuilder<> &Builder          = CG.getBuilder();
+    Type *Int64Ty                 = Builder.getInt64Ty();
+
+    //not a locked add: concurrent callers may lose a count, the hook copes with being called twice
+    Value *Counter  = hostPointer(CG, &Slot->Entries, Int64Ty);
+    LoadInst *Count = Builder.CreateAlignedLoad(Int64Ty, Counter, 8, "entries");
+    Count->setAtomic(AtomicOrdering::Monotonic);
+    Value *NewCount = Builder.CreateAdd(Count, Builder.getInt64(1), "entries");
+    Builder.CreateAlignedStore(NewCount, Counter, 8)->setAtomic(AtomicOrdering::Monotonic);
+
+    BasicBlock *TierUpBB = BasicBlock::Create(CG.getContext(), "tierup", F);
+    BasicBlock *BodyBB   = BasicBlock::Create(CG.getContext(), "body", F);
+    Builder.CreateCondBr(Builder.CreateICmpEQ(NewCount, Builder.getInt64(Counting.Threshold), "hot"), TierUpBB, BodyBB);
+
+    Builder.SetInsertPoint(TierUpBB);
+    Type *Int8PtrTy      = Builder.getInt8PtrTy();
+    Type *HookArgs[]     = {Int8PtrTy, Int8PtrTy};
+    FunctionType *HookTy = FunctionType::get(Builder.getVoidTy(), HookArgs, false);
+    Constant *HookAddr   = ConstantInt::get(Int64Ty, (uint64_t)(uintptr_t)Counting.TierUp);
+    Value *Args[]        = {hostPointer(CG, Counting.Context, Builder.getInt8Ty()), hostPointer(CG, Slot, Builder.getInt8Ty())};
+    Builder.CreateCall(HookTy, ConstantExpr::getIntToPtr(HookAddr, HookTy->getPointerTo()), Args);
+    Builder.CreateBr(BodyBB);
+
+    Builder.SetInsertPoint(BodyBB);
+}
+
+/// emitMemoWrapper - the body of F when it is memoized: look its arguments up
+/// in Table, on a miss call Body (the definition) and insert what it returns
+static void emitMemoWrapper(CodegenContext &CG, Function *F, Function *Body, MemoTable *Table) {
+    IRBuilder<> &Builder = CG.getBuilder();
+    Type *DoubleTy       = Builder.getDoubleTy();
+    Type *DoublePtrTy    = DoubleTy->getPointerTo();
+    Type *Int8PtrTy      = Builder.getInt8PtrTy();
+    Type *Int64Ty        = Builder.getInt64Ty();
+
+    BasicBlock *Entry  = BasicBlock::Create(CG.getContext(), "entry", F);
+    BasicBlock *HitBB  = BasicBlock::Create(CG.getContext(), "hit", F);
+    BasicBlock *MissBB = BasicBlock::Create(CG.getContext(), "miss", F);
+
+    //the table reads the key from memory, one double per argument
+    Builder.SetInsertPoint(Entry);
+    Value *Key = Builder.CreateAlloca(DoubleTy, Builder.getInt32(std::max<size_t>(1, F->arg_size())), "key");
+    std::vector<Value *> Args;
+    for (auto &Arg : F->args()) {
+        Builder.CreateAlignedStore(&Arg, Builder.CreateConstInBoundsGEP1_32(DoubleTy, Key, Arg.getArgNo()), 8);
+        Args.push_back(&Arg);
+    }
+    Value *Cached          = Builder.CreateAlloca(DoubleTy, nullptr, "cached");
+    Value *TablePtr        = hostPointer(CG, Table, Builder.getInt8Ty());
+    Type *LookupArgs[]     = {Int8PtrTy, DoublePtrTy, DoublePtrTy};
+    FunctionType *LookupTy = FunctionType::get(Builder.getInt32Ty(), LookupArgs, false);
+    Constant *LookupAddr   = ConstantInt::get(Int64Ty, (uint64_t)(uintptr_t)&MemoTable::lookup);
+    Value *LookupCall[]    = {TablePtr, Key, Cached};
+    Value *Found = Builder.CreateCall(LookupTy, ConstantExpr::getIntToPtr(LookupAddr, LookupTy->getPointerTo()),
+                                      LookupCall, "found");
+    Builder.CreateCondBr(Builder.CreateICmpNE(Found, Builder.getInt32(0)), HitBB, MissBB);
+
+    Builder.SetInsertPoint(HitBB);
+    Builder.CreateRet(Builder.CreateAlignedLoad(DoubleTy, Cached, 8, "cached"));
+
+    Builder.SetInsertPoint(MissBB);
+    Value *Result          = Builder.CreateCall(Body, Args, "result");
+    Type *InsertArgs[]     = {Int8PtrTy, DoublePtrTy, DoubleTy};
+    FunctionType *InsertTy = FunctionType::get(Builder.getVoidTy(), InsertArgs, false);
+    Constant *InsertAddr   = ConstantInt::get(Int64Ty, (uint64_t)(uintptr_t)&MemoTable::insert);
+    Value *InsertCall[]    = {TablePtr, Key, Result};
+    Builder.CreateCall(InsertTy, ConstantExpr::getIntToPtr(InsertAddr, InsertTy->getPointerTo()), InsertCall);
+    Builder.CreateRet(Result);
+}
+
+/// emitFunction - the part of FunctionAST::codegen that does not depend on how
+/// the body is stored: find or declare the function, bind the arguments in
+/// NamedValues and wrap the value EmitBody returns in a ret.
+static Function *emitFunction(CodegenContext &CG, PrototypeAST &Proto, function_ref<Value *()> EmitBody) {
+    //a memoized definition is a wrapper around the function the body goes into,
+    //which it alone calls. Recursive calls in the body go through the wrapper
+    MemoTable *Table = CG.takeMemoTable();
+
     //First, check for an existing function from a previous 'extern' declaration
-    Function *TheFunction = TheModule->getFunction(Proto->getName());
+    Function *TheFunction = CG.getFunction(Proto.getName());
     if (!TheFunction) {
-        TheFunction = Proto->codegen();
+        TheFunction = Proto.codegen(CG);
     }
 
     if (!TheFunction) {
@@ -92,27 +425,121 @@ Function *FunctionAST::codegen() {
         return (Function *)LogErrorV("Function cannot be redefined.");
     }
 
+    if (TheFunction->arg_size() != Proto.getNumArgs()) {
+        return (Function *)LogErrorV("Definition does not match the # arguments of its extern");
+    }
+
+    Function *BodyFunction = TheFunction;
+    if (Table) {
+        BodyFunction = Function::Create(TheFunction->getFunctionType(), Function::InternalLinkage,
+                                        TheFunction->getName() + ".body", CG.getModule());
+    }
+
+    CG.addFPAttributes(*TheFunction);
+    if (Table) {
+        CG.addFPAttributes(*BodyFunction);
+    }
+
     //Create a new basic block to start insertion into
-    BasicBlock *BB = BasicBlock::Create(TheContext, "entry", TheFunction);
+    BasicBlock *BB = BasicBlock::Create(CG.getContext(), "entry", BodyFunction);
     //The second line then tells the builder that new instructions should be inserted into the end of the new basic block.
-    Builder.SetInsertPoint(BB);
+    CG.getBuilder().SetInsertPoint(BB);
+    if (CG.countsEntries() && sym_anon != Proto.getName()) {
+        emitEntryCounter(CG, BodyFunction, Proto.getName());
+    }
 
     //Record the funnction arguments in the NameValues map
-    NamedValues.clear();
-    //we add the function arguments to the NamedValues map (after first clearing it out) so that they’re accessible to VariableExprAST nodes.
-    for (auto &Arg : TheFunction->args()) {
-        NamedValues[Arg.getName()] = &Arg;
+    //the arguments are the outermost scope of the body, gone again when it is done
+    ScopedSymbolTable<Value *>::Scope ArgScope(CG.NamedValues);
+    //keyed by the symbols of this definition, an earlier extern may have named the arguments differently
+    for (auto &Arg : BodyFunction->args()) {
+        if (Table) {
+            Arg.setName(getSymbolName(Proto.getArg(Arg.getArgNo())));
+        }
+        CG.NamedValues.bind(Proto.getArg(Arg.getArgNo()), &Arg);
     }
 
-    if (Value *RetVal = Body->codegen()) {
+    if (Value *RetVal = EmitBody()) {
         //Finish off the function
-        Builder.CreateRet(RetVal);
+        CG.getBuilder().CreateRet(RetVal);
+        if (Table) {
+            verifyFunction(*BodyFunction);
+            CG.runFunctionPasses(*BodyFunction);
+            emitMemoWrapper(CG, TheFunction, BodyFunction, Table);
+        }
 
         //Validate the generated code, checking for consistency
         verifyFunction(*TheFunction);
+        CG.runFunctionPasses(*TheFunction);
         return TheFunction;
     }
-    //error reading body, remove function
-    TheFunction->eraseFromParent();
+    if (Table) {
+        BodyFunction->eraseFromParent();
+    }
+    //error reading body, remove function. One that is already called (being
+    //recompiled by a reload) stays declared so the callers remain valid
+    if (!TheFunction->use_empty()) {
+        TheFunction->deleteBody();
+        return nullptr;
+    }
+    CG.removeFunction(TheFunction);
     return nullptr;
+}
+
+Function *FunctionAST::codegen(CodegenContext &CG) {
+    return emitFunction(CG, *Proto, [&]() { return Body->codegen(CG); });
+}
+
+//===----------------------------------------------------------------------===//
+// Code generation from the flat AST
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// FlatCodegen - the codegen() methods of the ExprAST classes as one switch
+class FlatCodegen : public FlatVisitor<FlatCodegen, Value *> {
+    CodegenContext &CG;
+
+   public:
+    FlatCodegen(CodegenContext &CG, const FlatAST &AST) : FlatVisitor(AST), CG(CG) {}
+
+    Value *visitNumber(NodeIdx N) { return ConstantFP::get(CG.getContext(), APFloat(AST.getNumber(N))); }
+
+    Value *visitVariable(NodeIdx N) {
+        Value *V = CG.NamedValues.lookup(AST.getSymbol(N));
+        if (!V) {
+            LogErrorV("Unkonw variable name");
+        }
+        return V;
+    }
+
+    Value *visitBinary(NodeIdx N) {
+        Value *L = visit(AST.getLHS(N));
+        Value *R = visit(AST.getRHS(N));
+        if (!L || !R) {
+            return nullptr;
+        }
+        return emitBinary(CG, AST.getOp(N), L, R);
+    }
+
+    Value *visitCall(NodeIdx N) {
+        ArrayRef<NodeIdx> Args = AST.getArgs(N);
+        return emitCall(CG, AST.getSymbol(N), Args.size(), [&](size_t i) { return visit(Args[i]); });
+    }
+
+    Value *visitIf(NodeIdx N) {
+        ArrayRef<NodeIdx> Ops = AST.getOperands(N);
+        return emitIf(CG, [&]() { return visit(Ops[0]); }, [&]() { return visit(Ops[1]); },
+                      [&]() { return visit(Ops[2]); });
+    }
+
+    Value *visitFor(NodeIdx N) {
+        ArrayRef<NodeIdx> Ops = AST.getOperands(N);
+        return emitFor(CG, AST.getSymbol(N), [&]() { return visit(Ops[0]); }, [&]() { return visit(Ops[1]); },
+                       [&]() { return visit(Ops[2]); }, [&]() { return visit(Ops[3]); });
+    }
+};
+}  // end anonymous namespace
+
+Function *FlatFunctionAST::codegen(CodegenContext &CG) {
+    return emitFunction(CG, *Proto, [&]() { return FlatCodegen(CG, Body).visit(Root); });
 }
\ No newline at end of file
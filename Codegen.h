@@ -1,10 +1,98 @@
 #ifndef __CODEGEN_H__
 #define __CODEGEN_H__
 #include "AllInclude.h"
+#include "CallSlot.h"
+#include "ScopedSymbolTable.h"
+#include "Symbol.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/LegacyPassManager.h"
 
-static LLVMContext TheContext;
-static IRBuilder<> Builder;
-static std::unique_ptr<Module> TheModule;
-static std::map<std::string, Value *> NamedValues;
+class MemoTable;
+class PrototypeAST;
 
-#endif
\ No newline at end of file
+/// FunctionProtoMap - the prototypes of functions that live outside the module
+/// being generated (handed to the JIT already, or compiled on another thread),
+/// calls to them go through a declaration made from the prototype
+typedef DenseMap<SymbolID, std::unique_ptr<PrototypeAST>> FunctionProtoMap;
+
+/// CodegenContext - one compilation: the LLVMContext and the module the code
+/// goes into, the builder, the passes run on each finished function and the
+/// symbol tables. Nothing is shared between two contexts, so each thread can
+/// compile into its own at the same time. The codegen() methods of the AST
+/// take the context to generate into.
+class CodegenContext {
+    std::unique_ptr<LLVMContext> Context;
+    std::unique_ptr<Module> TheModule;
+    IRBuilder<> Builder;
+    std::unique_ptr<legacy::FunctionPassManager> FPM;
+    bool FPMInitialized;
+    const FunctionProtoMap *FunctionProtos;
+    CallSlotTable *CallSlots;
+    EntryCounting Counting;
+    MemoTable *Memo;
+
+   public:
+    //NamedValues - the variables in scope while a body is generated
+    ScopedSymbolTable<Value *> NamedValues;
+    //FunctionTable - the functions of the module by symbol, saves the string lookup of getFunction(Name)
+    DenseMap<SymbolID, Function *> FunctionTable;
+
+    //the members are declared in dependency order, the LLVMContext is destroyed last
+    //FunctionProtos is only read, several contexts may share one
+    explicit CodegenContext(StringRef ModuleName, const FunctionProtoMap *FunctionProtos = nullptr);
+
+    LLVMContext &getContext() { return *Context; }
+    Module &getModule() { return *TheModule; }
+    IRBuilder<> &getBuilder() { return Builder; }
+
+    /// getFunction - Name from FunctionTable, or else a new declaration made
+    /// from its prototype in FunctionProtos. Null if neither knows it.
+    Function *getFunction(SymbolID Name);
+
+    /// takeModule - hand the module over (e.g. to the JIT) and continue in a new,
+    /// empty one with the same name and data layout. Its functions are declared
+    /// again through FunctionProtos when they are called. The module still
+    /// belongs to this LLVMContext, which must outlive it. Passes added with
+    /// addFunctionPass belong to the old module.
+    std::unique_ptr<Module> takeModule();
+
+    /// addFunctionPass - run P on every function from now on, once it has been
+    /// generated and verified. There are none by default.
+    void addFunctionPass(Pass *P) { FPM->add(P); }
+    void runFunctionPasses(Function &F);
+
+    /// setFastMathFlags - put FMF on the floating point operations generated
+    /// from now on (none by default)
+    void setFastMathFlags(FastMathFlags FMF) { Builder.setFastMathFlags(FMF); }
+
+    /// addFPAttributes - the function attributes that tell instruction
+    /// selection in F about those flags. The JIT resets the TargetOptions
+    /// of the same names for every function from these.
+    void addFPAttributes(Function &F);
+
+    /// removeFunction - erase F from the module and FunctionTable, nothing may call it
+    void removeFunction(Function *F);
+
+    /// setCallSlots - from now on, a call to a function whose slot in Slots has
+    /// an address loads the callee from the slot and calls it indirectly
+    void setCallSlots(CallSlotTable *Slots) { CallSlots = Slots; }
+    CallSlotTable *getCallSlots() { return CallSlots; }
+
+    /// setEntryCounting - make the definitions generated from now on count
+    /// their entries in their call slot (created as needed). Top-level
+    /// expressions run once and are not counted. Needs call slots.
+    void setEntryCounting(const EntryCounting &C) { Counting = C; }
+    const EntryCounting &getEntryCounting() const { return Counting; }
+    bool countsEntries() const { return Counting.TierUp != nullptr; }
+
+    /// setMemoTable - generate the next definition as a wrapper that caches
+    /// its results in T (null: not memoized). Applies to that one only.
+    void setMemoTable(MemoTable *T) { Memo = T; }
+    MemoTable *takeMemoTable() {
+        MemoTable *T = Memo;
+        Memo         = nullptr;
+        return T;
+    }
+};
+
+#endif
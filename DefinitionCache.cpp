@@ -0,0 +1,145 @@
+#include "DefinitionCache.h"
+#include "Codegen.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "TokenBuffer.h"
+#include "llvm/Support/xxhash.h"
+
+DefinitionCache::LoadStats DefinitionCache::load(SourceBuffer &Source, Emitter Emit) {
+    LoadStats Stats = {0, 0, 0, 0};
+
+    //the last load's expressions are done with, they are emitted again below
+    for (auto &Seg : Segments) {
+        for (size_t I = 0; I != Seg.Items.size(); ++I) {
+            if (TopLevelItem::Expression == Seg.Items[I].Kind && Seg.Functions[I]) {
+                CG.removeFunction(Seg.Functions[I]);
+                Seg.Functions[I] = nullptr;
+            }
+        }
+    }
+
+    //old segments by hash, a segment can be repeated word for word
+    DenseMap<uint64_t, SmallVector<unsigned, 1>> OldByHash;
+    for (unsigned I = 0; I != Segments.size(); ++I) {
+        OldByHash[Segments[I].Hash].push_back(I);
+    }
+    std::vector<bool> Taken(Segments.size(), false);
+
+    //segment K is the bytes [Starts[K], Starts[K + 1]). Only the keywords are
+    //looked for here, the segments that changed are lexed for real below
+    std::vector<size_t> Starts(1, 0);
+    Lexer Skim(Source);
+    size_t Size = Source.end() - Source.begin();
+    for (size_t Off; (Off = Skim.skimToTopLevel()) != Size; Skim.gettok()) {
+        if (Off != 0) {
+            Starts.push_back(Off);
+        }
+    }
+    Starts.push_back(Size);
+
+    std::vector<Segment> NewSegments;
+    //FreshArity - the argument count of every function the reparsed segments declare
+    DenseMap<SymbolID, unsigned> FreshArity;
+    for (size_t K = 0; K + 1 < Starts.size(); ++K) {
+        size_t Begin = Starts[K], End = Starts[K + 1];
+        uint64_t Hash = xxHash64(StringRef(Source.begin() + Begin, End - Begin));
+
+        auto It = OldByHash.find(Hash);
+        if (It != OldByHash.end()) {
+            auto Free = std::find_if(It->second.begin(), It->second.end(), [&](unsigned I) { return !Taken[I]; });
+            if (Free != It->second.end()) {
+                Taken[*Free] = true;
+                NewSegments.push_back(std::move(Segments[*Free]));
+                NewSegments.back().NeedsEmit = false;
+                ++Stats.Reused;
+                continue;
+            }
+        }
+
+        Segment Seg;
+        Seg.Hash      = Hash;
+        Seg.NeedsEmit = true;
+        Lexer Lex(Source, Source.begin() + Begin);
+        TokenBuffer Toks;
+        Toks.tokenize(Lex, End);
+        Parser P(Toks);
+        P.getNextToken();
+        parseTopLevelItems(P, Seg.Items);
+        Seg.Functions.assign(Seg.Items.size(), nullptr);
+        for (auto &Item : Seg.Items) {
+            PrototypeAST &Proto = Item.Proto ? *Item.Proto : Item.Function->getProto();
+            if (TopLevelItem::Expression != Item.Kind) {
+                FreshArity[Proto.getName()] = Proto.getNumArgs();
+            }
+        }
+        NewSegments.push_back(std::move(Seg));
+        ++Stats.Reparsed;
+    }
+
+    //the definitions of segments that are gone lose their bodies. Their functions
+    //stay as they are if a reparsed segment defines them again with the same
+    //arguments, otherwise their callers are recompiled and they are removed
+    DenseMap<Function *, unsigned> Owner;
+    for (unsigned I = 0; I != NewSegments.size(); ++I) {
+        for (Function *F : NewSegments[I].Functions) {
+            if (F) {
+                Owner[F] = I;
+            }
+        }
+    }
+    std::vector<Function *> Dropped;
+    for (unsigned I = 0; I != Segments.size(); ++I) {
+        if (Taken[I]) {
+            continue;
+        }
+        for (size_t J = 0; J != Segments[I].Items.size(); ++J) {
+            Function *F = Segments[I].Functions[J];
+            if (!F) {
+                continue;
+            }
+            F->deleteBody();
+            auto It = FreshArity.find(Segments[I].Items[J].Function->getProto().getName());
+            if (It == FreshArity.end() || It->second != F->arg_size()) {
+                Dropped.push_back(F);
+            }
+        }
+    }
+    for (Function *F : Dropped) {
+        for (User *U : F->users()) {
+            auto *Call = dyn_cast<Instruction>(U);
+            auto It    = Call ? Owner.find(Call->getFunction()) : Owner.end();
+            if (It != Owner.end() && !NewSegments[It->second].NeedsEmit) {
+                NewSegments[It->second].NeedsEmit = true;
+                ++Stats.Recompiled;
+            }
+        }
+    }
+    for (auto &Seg : NewSegments) {
+        if (Seg.NeedsEmit) {
+            for (Function *F : Seg.Functions) {
+                if (F) {
+                    F->deleteBody();
+                }
+            }
+        }
+    }
+    for (Function *F : Dropped) {
+        if (F->use_empty()) {
+            CG.removeFunction(F);
+            ++Stats.Removed;
+        }
+    }
+
+    //generate code in source order, a definition can only call the ones above it
+    for (auto &Seg : NewSegments) {
+        for (size_t I = 0; I != Seg.Items.size(); ++I) {
+            if (Seg.NeedsEmit || TopLevelItem::Expression == Seg.Items[I].Kind) {
+                Function *F      = Emit(Seg.Items[I]);
+                Seg.Functions[I] = TopLevelItem::Extern == Seg.Items[I].Kind ? nullptr : F;
+            }
+        }
+    }
+
+    Segments = std::move(NewSegments);
+    return Stats;
+}
@@ -0,0 +1,57 @@
+#ifndef __DEFINITIONCACHE_H__
+#define __DEFINITIONCACHE_H__
+//===----------------------------------------------------------------------===//
+// Incremental reloading
+//===----------------------------------------------------------------------===//
+#include "AllInclude.h"
+#include "ParallelParser.h"
+#include "SourceBuffer.h"
+
+class CodegenContext;
+
+/// DefinitionCache - keeps the parsed items and generated functions of the last
+/// load of a script, so loading an edited version only redoes what changed.
+///
+/// The script is cut into segments at every 'def'/'extern': one item plus any
+/// top-level expressions after it. A segment whose text hashes the same as one
+/// of the last load reuses its ASTs and functions, the others are parsed and
+/// emitted again. A removed definition's callers are recompiled from their
+/// cached ASTs unless it comes back with the same number of arguments. Top-level
+/// expressions are emitted again on every load, they are what a load runs.
+/// Lexing and hashing still cover the whole text, parsing and codegen only the
+/// edit.
+class DefinitionCache {
+    struct Segment {
+        uint64_t Hash;
+        std::vector<TopLevelItem> Items;
+        //the function each definition or expression was emitted to, null for
+        //an extern or a failure
+        std::vector<Function *> Functions;
+        //reparsed, or reused but its code must be generated again
+        bool NeedsEmit;
+    };
+    //Segments - of the last load, in source order
+    std::vector<Segment> Segments;
+    //where the functions are
+    CodegenContext &CG;
+
+   public:
+    explicit DefinitionCache(CodegenContext &CG) : CG(CG) {}
+
+    /// Emitter - generate the code of one item into the CodegenContext of the
+    /// cache, return its function or null
+    typedef function_ref<Function *(TopLevelItem &)> Emitter;
+
+    struct LoadStats {
+        unsigned Reused;
+        unsigned Reparsed;
+        unsigned Recompiled;
+        unsigned Removed;
+    };
+
+    /// load - bring the module up to date with Source, which must not be
+    /// interactive. The first load parses and emits everything.
+    LoadStats load(SourceBuffer &Source, Emitter Emit);
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include "DefinitionLibrary.h"
+#include "Error.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+void DefinitionLibrary::addModule(const Module &M) {
+    std::shared_ptr<Module> Copy(CloneModule(M));
+    for (Function &F : *Copy) {
+        if (!F.isDeclaration() && F.hasExternalLinkage()) {
+            Modules[F.getName()] = Copy;
+        }
+    }
+}
+
+/// isImportable - whether a copy of F may go into another module: small
+/// enough, and referring to nothing that is private to its own module (like
+/// the body behind a memoized definition)
+bool DefinitionLibrary::isImportable(const Function &F) const {
+    if (F.getInstructionCount() > SizeLimit) {
+        return false;
+    }
+    for (const Instruction &I : instructions(F)) {
+        for (const Value *Op : I.operands()) {
+            auto *GV = dyn_cast<GlobalValue>(Op);
+            if (GV && GV->hasLocalLinkage()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+unsigned DefinitionLibrary::importCallees(std::unique_ptr<Module> &M) {
+    //only the callees of M itself: the IR kept for a definition had its own
+    //callees imported, and inlined where that paid off, when it was optimized
+    SmallVector<const Function *, 8> Defs;
+    for (Function &F : *M) {
+        if (!F.isDeclaration() || F.use_empty()) {
+            continue;
+        }
+        auto It = Modules.find(F.getName());
+        if (It != Modules.end() && isImportable(*It->second->getFunction(F.getName()))) {
+            Defs.push_back(It->second->getFunction(F.getName()));
+        }
+    }
+    if (Defs.empty()) {
+        return 0;
+    }
+    //a link that fails may leave the module half linked: link into a copy,
+    //M stays as it is unless all of them went in
+    std::unique_ptr<Module> Linked = CloneModule(*M);
+    for (const Function *Def : Defs) {
+        //the copy declares everything else in the module, the linker only takes what Def uses
+        ValueToValueMapTy VMap;
+        std::unique_ptr<Module> Copy =
+            CloneModule(*Def->getParent(), VMap, [&](const GlobalValue *GV) { return GV == Def; });
+        Copy->getFunction(Def->getName())->setLinkage(GlobalValue::AvailableExternallyLinkage);
+        if (Linker::linkModules(*Linked, std::move(Copy))) {
+            std::string Message = "could not import '" + Def->getName().str() + "' for inlining";
+            LogError(Message.c_str());
+            return 0;
+        }
+    }
+    M = std::move(Linked);
+    NumImported += Defs.size();
+    return Defs.size();
+}
@@ -0,0 +1,43 @@
+#ifndef __DEFINITIONLIBRARY_H__
+#define __DEFINITIONLIBRARY_H__
+//===----------------------------------------------------------------------===//
+// Cross-module inlining for the JIT
+//===----------------------------------------------------------------------===//
+// Every definition goes to the JIT in a module of its own, so a later module
+// only has a declaration of it and the inliner never sees its body. The
+// library keeps a copy of the optimized IR of each definition; before a new
+// module is optimized, the definitions it calls are copied into it with
+// available_externally linkage. The inliner may inline them, but no code is
+// generated for them: a call that stays a call goes to the code the JIT
+// already has.
+#include "AllInclude.h"
+#include "llvm/ADT/StringMap.h"
+
+class DefinitionLibrary {
+    //the optimized module of each definition by function name, the modules
+    //belong to the LLVMContext of the ones the definitions are imported into
+    StringMap<std::shared_ptr<Module>> Modules;
+    unsigned SizeLimit;
+    unsigned NumImported;
+
+    bool isImportable(const Function &F) const;
+
+   public:
+    //definitions with more than SizeLimit instructions are not imported
+    explicit DefinitionLibrary(unsigned SizeLimit) : SizeLimit(SizeLimit), NumImported(0) {}
+
+    /// addModule - keep a copy of the definitions in M, which has been
+    /// optimized and is about to go to the JIT
+    void addModule(const Module &M);
+
+    /// importCallees - give the declarations called in M the bodies kept for
+    /// them, as available_externally copies. Before M is optimized, M must be
+    /// in the LLVMContext of the modules added. M is replaced by a module with
+    /// the copies linked in, or left alone if one of them fails to link.
+    /// Returns how many were imported.
+    unsigned importCallees(std::unique_ptr<Module> &M);
+
+    unsigned getNumImported() const { return NumImported; }
+};
+
+#endif
@@ -1,6 +1,6 @@
 #include "Error.h"
 //.logError* - these are little helper functions for error handling
-std::unique_ptr<ExprAST> LogError(const char *Str) {
+ExprAST *LogError(const char *Str) {
     fprintf(stderr, "LogError: %s\n", Str);
     return nullptr;
 }
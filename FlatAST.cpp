@@ -0,0 +1,55 @@
+#include "FlatAST.h"
+#include "AST.h"
+
+//===----------------------------------------------------------------------===//
+// ExprAST -> FlatAST
+//===----------------------------------------------------------------------===//
+
+FlatAST::NodeIdx NumberExprAST::flatten(FlatAST &Flat) const {
+    return Flat.addNumber(Val);
+}
+
+FlatAST::NodeIdx VariableExprAST::flatten(FlatAST &Flat) const {
+    return Flat.addVariable(Name);
+}
+
+FlatAST::NodeIdx BinaryExprAST::flatten(FlatAST &Flat) const {
+    FlatAST::NodeIdx L = getLHS()->flatten(Flat);
+    FlatAST::NodeIdx R = getRHS()->flatten(Flat);
+    return Flat.addBinary(Op, L, R);
+}
+
+FlatAST::NodeIdx CallExprAST::flatten(FlatAST &Flat) const {
+    SmallVector<FlatAST::NodeIdx, 8> ArgIdx;
+    for (ExprAST *Arg : Args) {
+        ArgIdx.push_back(Arg->flatten(Flat));
+    }
+    return Flat.addCall(Callee, ArgIdx);
+}
+
+FlatAST::NodeIdx IfExprAST::flatten(FlatAST &Flat) const {
+    FlatAST::NodeIdx C = getCond()->flatten(Flat);
+    FlatAST::NodeIdx T = getThen()->flatten(Flat);
+    FlatAST::NodeIdx E = getElse()->flatten(Flat);
+    return Flat.addIf(C, T, E);
+}
+
+FlatAST::NodeIdx ForExprAST::flatten(FlatAST &Flat) const {
+    FlatAST::NodeIdx S = getStart()->flatten(Flat);
+    FlatAST::NodeIdx E = getEnd()->flatten(Flat);
+    FlatAST::NodeIdx I = getStep()->flatten(Flat);
+    FlatAST::NodeIdx B = getBody()->flatten(Flat);
+    return Flat.addFor(VarName, S, E, I, B);
+}
+
+std::unique_ptr<FlatFunctionAST> FunctionAST::flatten() const {
+    FlatAST Flat;
+    FlatAST::NodeIdx Root = Body->flatten(Flat);
+    return llvm::make_unique<FlatFunctionAST>(llvm::make_unique<PrototypeAST>(*Proto), std::move(Flat), Root);
+}
+
+FlatFunctionAST::FlatFunctionAST(std::unique_ptr<PrototypeAST> Proto, FlatAST Body, FlatAST::NodeIdx Root)
+    : Proto(std::move(Proto)), Body(std::move(Body)), Root(Root) {}
+
+//out of line, PrototypeAST is incomplete in FlatAST.h
+FlatFunctionAST::~FlatFunctionAST() {}
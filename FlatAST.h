@@ -0,0 +1,133 @@
+#ifndef __FLATAST_H__
+#define __FLATAST_H__
+#include "AllInclude.h"
+#include "Symbol.h"
+//===----------------------------------------------------------------------===//
+// Flat AST
+//===----------------------------------------------------------------------===//
+// A compact form of an expression tree, kept alongside the ExprAST classes.
+// Nodes live in parallel arrays and refer to their children by 32-bit index;
+// a node is a kind tag plus two words (10 bytes) instead of a heap object with
+// a vtable, and passes dispatch on the tag with a switch (FlatVisitor).
+// Children are always added before their parent, so walking the indices
+// upwards visits every child before its parent.
+
+class CodegenContext;
+class PrototypeAST;
+
+enum FlatKind : uint8_t {
+    flat_number,    // A = index into Numbers
+    flat_variable,  // A = SymbolID
+    flat_binary,    // Op, A = LHS, B = RHS
+    flat_call,      // A = callee SymbolID, B = index into Operands of [# args, arg...]
+    flat_if,        // B = index into Operands of [3, cond, then, else]
+    flat_for,       // A = loop variable SymbolID, B = index into Operands of [4, start, end, step, body]
+};
+
+class FlatAST {
+   public:
+    typedef uint32_t NodeIdx;
+
+   private:
+    std::vector<uint8_t> Kinds;
+    std::vector<char> Ops;
+    std::vector<uint32_t> A, B;
+    std::vector<double> Numbers;
+    std::vector<NodeIdx> Operands;
+
+    NodeIdx addNode(FlatKind Kind, char Op, uint32_t AVal, uint32_t BVal) {
+        Kinds.push_back(Kind);
+        Ops.push_back(Op);
+        A.push_back(AVal);
+        B.push_back(BVal);
+        return Kinds.size() - 1;
+    }
+    uint32_t addOperands(ArrayRef<NodeIdx> Nodes) {
+        uint32_t First = Operands.size();
+        Operands.push_back(Nodes.size());
+        Operands.insert(Operands.end(), Nodes.begin(), Nodes.end());
+        return First;
+    }
+
+   public:
+    NodeIdx addNumber(double Val) {
+        Numbers.push_back(Val);
+        return addNode(flat_number, 0, Numbers.size() - 1, 0);
+    }
+    NodeIdx addVariable(SymbolID Name) { return addNode(flat_variable, 0, Name, 0); }
+    NodeIdx addBinary(char Op, NodeIdx LHS, NodeIdx RHS) { return addNode(flat_binary, Op, LHS, RHS); }
+    NodeIdx addCall(SymbolID Callee, ArrayRef<NodeIdx> Args) { return addNode(flat_call, 0, Callee, addOperands(Args)); }
+    NodeIdx addIf(NodeIdx Cond, NodeIdx Then, NodeIdx Else) {
+        NodeIdx Ops[] = {Cond, Then, Else};
+        return addNode(flat_if, 0, 0, addOperands(Ops));
+    }
+    NodeIdx addFor(SymbolID VarName, NodeIdx Start, NodeIdx End, NodeIdx Step, NodeIdx Body) {
+        NodeIdx Ops[] = {Start, End, Step, Body};
+        return addNode(flat_for, 0, VarName, addOperands(Ops));
+    }
+
+    size_t size() const { return Kinds.size(); }
+    FlatKind getKind(NodeIdx N) const { return (FlatKind)Kinds[N]; }
+    double getNumber(NodeIdx N) const { return Numbers[A[N]]; }
+    //the variable name, the callee of a call or the loop variable of a for
+    SymbolID getSymbol(NodeIdx N) const { return A[N]; }
+    char getOp(NodeIdx N) const { return Ops[N]; }
+    NodeIdx getLHS(NodeIdx N) const { return A[N]; }
+    NodeIdx getRHS(NodeIdx N) const { return B[N]; }
+    //the children of a call, if or for, in the order of the comments on FlatKind
+    ArrayRef<NodeIdx> getOperands(NodeIdx N) const {
+        return ArrayRef<NodeIdx>(Operands.data() + B[N] + 1, Operands[B[N]]);
+    }
+    ArrayRef<NodeIdx> getArgs(NodeIdx N) const { return getOperands(N); }
+};
+
+/// FlatVisitor - switch dispatch over the node kinds, in the style of LLVM's
+/// InstVisitor. Derived implements visitNumber/visitVariable/visitBinary/
+/// visitCall/visitIf/visitFor(NodeIdx) and recurses with visit() where it
+/// wants to.
+template <typename Derived, typename RetTy = void>
+class FlatVisitor {
+   protected:
+    const FlatAST &AST;
+
+   public:
+    typedef FlatAST::NodeIdx NodeIdx;
+
+    explicit FlatVisitor(const FlatAST &AST) : AST(AST) {}
+
+    RetTy visit(NodeIdx N) {
+        Derived &D = *static_cast<Derived *>(this);
+        switch (AST.getKind(N)) {
+            case flat_number:
+                return D.visitNumber(N);
+            case flat_variable:
+                return D.visitVariable(N);
+            case flat_binary:
+                return D.visitBinary(N);
+            case flat_call:
+                return D.visitCall(N);
+            case flat_if:
+                return D.visitIf(N);
+            case flat_for:
+                return D.visitFor(N);
+        }
+        llvm_unreachable("unknown flat node kind");
+    }
+};
+
+/// FlatFunctionAST - a function definition whose body is a FlatAST
+class FlatFunctionAST {
+    std::unique_ptr<PrototypeAST> Proto;
+    FlatAST Body;
+    FlatAST::NodeIdx Root;
+
+   public:
+    FlatFunctionAST(std::unique_ptr<PrototypeAST> Proto, FlatAST Body, FlatAST::NodeIdx Root);
+    ~FlatFunctionAST();
+
+    const FlatAST &getBody() const { return Body; }
+    FlatAST::NodeIdx getRoot() const { return Root; }
+    Function *codegen(CodegenContext &CG);
+};
+
+#endif
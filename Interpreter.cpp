@@ -0,0 +1,246 @@
+#include "Interpreter.h"
+#include "AST.h"
+#include "ScopedSymbolTable.h"
+#include "llvm/ADT/DenseMap.h"
+#include <cmath>
+
+namespace {
+
+//the cost model, in ns, measured with -time-phases at -O0 (bench/interpret.sh).
+//Compiling a top-level expression takes a fixed part plus a part per node (a
+//loop is a lot of IR), running it then a part per node evaluated. The walk
+//only has the part per node evaluated, a larger one.
+const double CompileFixedCost  = 600000;
+const double CompileNodeCost   = 7500;
+const double CompileLoopCost   = 350000;
+const double CompiledNodeCost  = 1.5;
+const double InterpretNodeCost = 5;
+
+//the address each call site resolved to, found by the Checker for the Evaluator
+typedef DenseMap<const CallExprAST *, void *> CallSiteMap;
+
+/// Checker - whether every node of a tree can be evaluated, checked first so
+/// that no extern with side effects runs before the walk gives up, and what
+/// evaluating it would cost
+class Checker {
+    CalleeResolver Resolve;
+    //the loop variables in scope
+    ScopedSymbolTable<bool> Variables;
+    CallSiteMap Callees;
+
+   public:
+    //the nodes and loops of the tree, and the nodes the walk would evaluate
+    double NumNodes, NumLoops, NumEvaluated;
+
+    explicit Checker(CalleeResolver Resolve) : Resolve(Resolve), NumNodes(0), NumLoops(0), NumEvaluated(0) {}
+
+    bool check(const ExprAST *E) {
+        NumNodes += 1;
+        NumEvaluated += 1;
+        switch (E->getKind()) {
+            case ExprAST::expr_number:
+                return true;
+            case ExprAST::expr_variable:
+                //top-level expressions have no arguments, only loops bind names
+                return Variables.lookup(cast<VariableExprAST>(E)->getName());
+            case ExprAST::expr_binary: {
+                auto *Bin = cast<BinaryExprAST>(E);
+                switch (Bin->getOp()) {
+                    case '+':
+                    case '-':
+                    case '*':
+                    case '<':
+                        return check(Bin->getLHS()) && check(Bin->getRHS());
+                    default:
+                        return false;
+                }
+            }
+            case ExprAST::expr_call: {
+                auto *Call = cast<CallExprAST>(E);
+                if (Call->getArgs().size() > MaxInterpretedArgs) {
+                    return false;
+                }
+                //resolved here once, not on every call the walk makes
+                void *Addr = Resolve(Call->getCallee(), Call->getArgs().size());
+                if (!Addr) {
+                    return false;
+                }
+                Callees[Call] = Addr;
+                for (const ExprAST *Arg : Call->getArgs()) {
+                    if (!check(Arg)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case ExprAST::expr_if: {
+                auto *If = cast<IfExprAST>(E);
+                if (!check(If->getCond())) {
+                    return false;
+                }
+                //only one branch runs, the dearer one counts
+                double Evaluated = NumEvaluated;
+                if (!check(If->getThen())) {
+                    return false;
+                }
+                double Then  = NumEvaluated - Evaluated;
+                NumEvaluated = Evaluated;
+                if (!check(If->getElse())) {
+                    return false;
+                }
+                NumEvaluated = Evaluated + std::max(Then, NumEvaluated - Evaluated);
+                return true;
+            }
+            case ExprAST::expr_for:
+                return checkFor(cast<ForExprAST>(E));
+        }
+        llvm_unreachable("unknown expression kind");
+    }
+
+    /// checkFor - a loop whose trip count is not a constant may run for any
+    /// time, it is left to compiled code
+    bool checkFor(const ForExprAST *For) {
+        auto *Start = dyn_cast<NumberExprAST>(For->getStart());
+        auto *End   = dyn_cast<NumberExprAST>(For->getEnd());
+        auto *Step  = dyn_cast<NumberExprAST>(For->getStep());
+        if (!Start || !End || !Step) {
+            return false;
+        }
+        NumNodes += 3;
+        NumLoops += 1;
+        NumEvaluated += 3;
+        double Evaluated = NumEvaluated;
+        {
+            ScopedSymbolTable<bool>::Scope LoopScope(Variables);
+            Variables.bind(For->getVarName(), true);
+            if (!check(For->getBody())) {
+                return false;
+            }
+        }
+        double TripCount = getTripCount(Start->getVal(), End->getVal(), Step->getVal());
+        NumEvaluated     = Evaluated + (NumEvaluated - Evaluated) * TripCount;
+        return true;
+    }
+
+    const CallSiteMap &getCallees() const { return Callees; }
+
+    /// compilingPaysOff - whether compiling and running the tree checked is
+    /// expected to take less time than walking it
+    bool compilingPaysOff() const {
+        double Compile = CompileFixedCost + NumNodes * CompileNodeCost + NumLoops * CompileLoopCost;
+        return NumEvaluated * InterpretNodeCost > Compile + NumEvaluated * CompiledNodeCost;
+    }
+};
+
+/// Evaluator - the value of a tree the Checker accepted
+class Evaluator {
+    const CallSiteMap &Callees;
+    //the current value of each loop variable in scope
+    ScopedSymbolTable<const double *> Variables;
+
+   public:
+    explicit Evaluator(const CallSiteMap &Callees) : Callees(Callees) {}
+
+    double evaluate(const ExprAST *E) {
+        switch (E->getKind()) {
+            case ExprAST::expr_number:
+                return cast<NumberExprAST>(E)->getVal();
+            case ExprAST::expr_variable:
+                return *Variables.lookup(cast<VariableExprAST>(E)->getName());
+            case ExprAST::expr_binary: {
+                auto *Bin = cast<BinaryExprAST>(E);
+                double L  = evaluate(Bin->getLHS());
+                double R  = evaluate(Bin->getRHS());
+                switch (Bin->getOp()) {
+                    case '+':
+                        return L + R;
+                    case '-':
+                        return L - R;
+                    case '*':
+                        return L * R;
+                    case '<':
+                        //fcmp ult: true if less or unordered
+                        return !(L >= R) ? 1.0 : 0.0;
+                }
+                break;
+            }
+            case ExprAST::expr_call: {
+                auto *Call = cast<CallExprAST>(E);
+                double Args[MaxInterpretedArgs];
+                size_t NumArgs = Call->getArgs().size();
+                for (size_t I = 0; I != NumArgs; ++I) {
+                    Args[I] = evaluate(Call->getArgs()[I]);
+                }
+                return callNative(Callees.lookup(Call), makeArrayRef(Args, NumArgs));
+            }
+            case ExprAST::expr_if: {
+                auto *If = cast<IfExprAST>(E);
+                //fcmp one: neither 0 nor NaN
+                double Cond = evaluate(If->getCond());
+                return evaluate(Cond < 0.0 || Cond > 0.0 ? If->getThen() : If->getElse());
+            }
+            case ExprAST::expr_for:
+                return evaluateFor(cast<ForExprAST>(E));
+        }
+        llvm_unreachable("expression the Checker rejects");
+    }
+
+    /// evaluateFor - the loop codegen emits: an integer counter k, the loop
+    /// variable Start + k * Step and the sum of the body values in order
+    double evaluateFor(const ForExprAST *For) {
+        double Start   = evaluate(For->getStart());
+        double End     = evaluate(For->getEnd());
+        double Step    = evaluate(For->getStep());
+        uint64_t Count = getTripCount(Start, End, Step);
+        double Sum     = 0.0;
+        double Var;
+        ScopedSymbolTable<const double *>::Scope LoopScope(Variables);
+        Variables.bind(For->getVarName(), &Var);
+        for (uint64_t K = 0; K != Count; ++K) {
+            Var = (double)K * Step + Start;
+            Sum += evaluate(For->getBody());
+        }
+        return Sum;
+    }
+};
+
+}  // end anonymous namespace
+
+double callNative(void *Addr, ArrayRef<double> A) {
+    typedef double D;
+    switch (A.size()) {
+        case 0:
+            return ((D(*)())Addr)();
+        case 1:
+            return ((D(*)(D))Addr)(A[0]);
+        case 2:
+            return ((D(*)(D, D))Addr)(A[0], A[1]);
+        case 3:
+            return ((D(*)(D, D, D))Addr)(A[0], A[1], A[2]);
+        case 4:
+            return ((D(*)(D, D, D, D))Addr)(A[0], A[1], A[2], A[3]);
+        case 5:
+            return ((D(*)(D, D, D, D, D))Addr)(A[0], A[1], A[2], A[3], A[4]);
+        case 6:
+            return ((D(*)(D, D, D, D, D, D))Addr)(A[0], A[1], A[2], A[3], A[4], A[5]);
+        case 7:
+            return ((D(*)(D, D, D, D, D, D, D))Addr)(A[0], A[1], A[2], A[3], A[4], A[5], A[6]);
+        case 8:
+            return ((D(*)(D, D, D, D, D, D, D, D))Addr)(A[0], A[1], A[2], A[3], A[4], A[5], A[6], A[7]);
+    }
+    llvm_unreachable("more arguments than MaxInterpretedArgs");
+}
+
+uint64_t getTripCount(double Start, double End, double Step) {
+    double Steps = std::ceil((End - Start) / Step);
+    return Steps > 0.0 ? (uint64_t)std::min(Steps, 9223372036854775808.0) : 0;
+}
+
+bool interpretTopLevelExpr(const FunctionAST &FnAST, CalleeResolver Resolve, double &Result) {
+    Checker Check(Resolve);
+    if (!Check.check(FnAST.getBody()) || Check.compilingPaysOff()) {
+        return false;
+    }
+    Result = Evaluator(Check.getCallees()).evaluate(FnAST.getBody());
+    return true;
+}
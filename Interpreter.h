@@ -0,0 +1,41 @@
+#ifndef __INTERPRETER_H__
+#define __INTERPRETER_H__
+//===----------------------------------------------------------------------===//
+// Direct evaluation of top-level expressions
+//===----------------------------------------------------------------------===//
+#include "AllInclude.h"
+#include "Symbol.h"
+
+class FunctionAST;
+
+//the most arguments a call made by the interpreter can pass
+const size_t MaxInterpretedArgs = 8;
+
+/// callNative - call the function at Addr, compiled Kaleidoscope code or a C
+/// function taking Args.size() doubles (at most MaxInterpretedArgs) and
+/// returning a double
+double callNative(void *Addr, ArrayRef<double> Args);
+
+/// CalleeResolver - the machine code address of the function Name called with
+/// NumArgs arguments, null if there is none or it takes another number
+typedef function_ref<void *(SymbolID Name, size_t NumArgs)> CalleeResolver;
+
+/// getTripCount - the iterations of a for, as codegen computes them:
+/// ceil((End - Start) / Step) if that is positive, at most 2^63
+uint64_t getTripCount(double Start, double End, double Step);
+
+/// interpretTopLevelExpr - evaluate the body of the top-level expression
+/// FnAST by walking the tree, without generating any code. Calls go straight
+/// to the compiled functions Resolve returns, it is asked once per call site
+/// before the walk starts. Computes the same IEEE result as
+/// the compiled expression (with strict floating point), operands and
+/// arguments are evaluated left to right as there.
+/// Returns false, having called nothing, if the expression needs what only
+/// compiled code can do: an unbound variable, a callee that does not resolve,
+/// a call with more than MaxInterpretedArgs arguments or a loop whose trip
+/// count is not a constant. Also when a cost model expects compiling and
+/// running it to be quicker, as for a long enough loop. Compiling it then
+/// reports the error or runs it.
+bool interpretTopLevelExpr(const FunctionAST &FnAST, CalleeResolver Resolve, double &Result);
+
+#endif
@@ -42,14 +42,16 @@ class KaleidoscopeJIT {
     using ObjLayerT     = LegacyRTDyldObjectLinkingLayer;
     using CompileLayerT = LegacyIRCompileLayer<ObjLayerT, SimpleCompiler>;
 
-    KaleidoscopeJIT()
+    /// CPU and Attrs (e.g. "+avx2") select the machine code, by default the
+    /// target's generic CPU
+    explicit KaleidoscopeJIT(StringRef CPU = "", const std::vector<std::string> &Attrs = {})
         : Resolver(createLegacyLookupResolver(
               ES,
               [this](const std::string &Name) {
                   return findMangledSymbol(Name);
               },
               [](Error Err) { cantFail(std::move(Err), "lookupFlags failed"); })),
-          TM(EngineBuilder().selectTarget()),
+          TM(EngineBuilder().setMCPU(CPU).setMAttrs(Attrs).selectTarget()),
           DL(TM->createDataLayout()),
           ObjectLayer(ES,
                       [this](VModuleKey) {
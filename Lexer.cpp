@@ -1,61 +1,102 @@
 //===----------------------------------------------------------------------===//
 // Lexer
 //===----------------------------------------------------------------------===//
-//return the next token fron standard input
+//return the next token fron the source buffer
 #include "Lexer.h"
 #include "Error.h"
-static int gettok() {
-    static int LastChar = ' ';
-    //skip any whitespace
-    while (isspace(LastChar)) {
-        LastChar = getchar();
+#include "NumberParser.h"
+#include "Scan.h"
+
+int Lexer::gettok() {
+    //skip any whitespace and comments, pull in the next line when the buffer runs out
+    while (1) {
+        if (CurPtr == BufEnd) {
+            //check for end of file
+            if (!Source.refill()) {
+                TokStart = CurPtr;
+                return tok_eof;
+            }
+            CurPtr = Source.begin();
+            BufEnd = Source.end();
+            continue;
+        }
+
+        if (isspace((unsigned char)*CurPtr)) {
+            CurPtr = CurScanners.SkipSpace(CurPtr, BufEnd);
+            continue;
+        }
+
+        //Comment until end of line, ignore comment
+        if ('#' == *CurPtr) {
+            CurPtr = CurScanners.SkipComment(CurPtr, BufEnd);
+            continue;
+        }
+        break;
     }
 
+    TokStart = CurPtr;
+
     //identifier: [a-zA-z][a-zA_Z0-9]*
-    if (isalpha(LastChar)) {
-        IdentifierStr = LastChar;
-        while (isalnum((LastChar = getchar()))) {
-            IdentifierStr += LastChar;
-        }
+    if (isalpha((unsigned char)*CurPtr)) {
+        CurPtr = CurScanners.SkipIdent(CurPtr + 1, BufEnd);
+        //hashed once here, everything after the lexer works with the ID
+        IdentifierSym = internSymbol(StringRef(TokStart, CurPtr - TokStart));
 
-        if ("def" == IdentifierStr) {
-            return tok_def;
-        } else if ("extern" == IdentifierStr) {
-            return tok_extern;
+        switch (IdentifierSym) {
+            case sym_def:
+                return tok_def;
+            case sym_extern:
+                return tok_extern;
+            case sym_if:
+                return tok_if;
+            case sym_then:
+                return tok_then;
+            case sym_else:
+                return tok_else;
+            case sym_for:
+                return tok_for;
+            case sym_in:
+                return tok_in;
         }
         return tok_identifier;
     }
 
     //Number: [0-9.]+
-    if (isdigit(LastChar) || LastChar == '.') {
-        std::string NumStr;
-        do {
-            NumStr += LastChar;
-            LastChar = getchar();
-        } while (isdigit(LastChar) || LastChar == '.');
-
-        NumVal = strtod(NumStr.c_str(), 0);
+    if (isdigit((unsigned char)*CurPtr) || '.' == *CurPtr) {
+        CurPtr = CurScanners.SkipNumber(CurPtr + 1, BufEnd);
+
+        //at most one '.', converted in place
+        if (!parseNumber(TokStart, CurPtr, NumVal)) {
+            LogError("malformed number literal");
+            return tok_error;
+        }
         return tok_number;
     }
 
-    //Comment until end of line, ignore comment
-    if ('#' == LastChar) {
-        do {
-            LastChar = getchar();
-        } while (LastChar != EOF && '\n' != LastChar && '\r' != LastChar);
+    //Otherwise, just return the character as its ascii value.
+    return (unsigned char)*CurPtr++;
+}
 
-        //ignore comment
-        if (EOF != LastChar) {
-            return gettok();
+size_t Lexer::skimToTopLevel() {
+    //the same token boundaries as gettok
+    while (CurPtr != BufEnd) {
+        if (isspace((unsigned char)*CurPtr)) {
+            CurPtr = CurScanners.SkipSpace(CurPtr, BufEnd);
+        } else if ('#' == *CurPtr) {
+            CurPtr = CurScanners.SkipComment(CurPtr, BufEnd);
+        } else if (isalpha((unsigned char)*CurPtr)) {
+            const char *Start = CurPtr;
+            CurPtr            = CurScanners.SkipIdent(CurPtr + 1, BufEnd);
+            StringRef Ident(Start, CurPtr - Start);
+            if ("def" == Ident || "extern" == Ident) {
+                CurPtr = Start;
+                return CurPtr - Source.begin();
+            }
+        } else if (isdigit((unsigned char)*CurPtr) || '.' == *CurPtr) {
+            CurPtr = CurScanners.SkipNumber(CurPtr + 1, BufEnd);
+        } else {
+            ++CurPtr;
         }
     }
-
-    //check for end of file, Do not eat the EOF
-    if (LastChar == EOF) {
-        return tok_eof;
-    }
-
-    int ThisChar = LastChar;
-    LastChar     = getchar();
-    return ThisChar;
+    return CurPtr - Source.begin();
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 // Lexer
 //===----------------------------------------------------------------------===//
 #include "AllInclude.h"
+#include "SourceBuffer.h"
+#include "Symbol.h"
 // The lexer returns tokens [0-255] if it is an unknown character, otherwise one
 // of these for known things.
 enum Token {
@@ -16,13 +18,56 @@ enum Token {
     //primary
     tok_identifier = -4,
     tok_number     = -5,
+
+    //a malformed token, the lexer has already reported it
+    tok_error = -6,
+
+    //control
+    tok_if   = -7,
+    tok_then = -8,
+    tok_else = -9,
+    tok_for  = -10,
+    tok_in   = -11,
 };
 
-//filled in if tok_identifier
-static std::string IdentifierStr;
-//filled in if tok_number
-static double NumVal;
+/// Lexer - turns one SourceBuffer into tokens. All lexing state lives in the
+/// object, so independent lexers can run side by side on different threads.
+class Lexer {
+    //Source - where the text comes from; CurPtr/BufEnd - the part of it not lexed yet
+    SourceBuffer &Source;
+    const char *CurPtr;
+    const char *BufEnd;
+    //TokStart - where the last token begins
+    const char *TokStart;
+
+    //filled in if tok_identifier, the interned spelling
+    SymbolID IdentifierSym;
+    //filled in if tok_number
+    double NumVal;
+
+   public:
+    //the lexer scans Src from the beginning, Src must outlive the lexer
+    explicit Lexer(SourceBuffer &Src)
+        : Source(Src), CurPtr(Src.begin()), BufEnd(Src.end()), TokStart(CurPtr), IdentifierSym(0), NumVal(0) {}
+    //scan Src from Start on, Start must be a token boundary (e.g. a line start)
+    //of a buffer that is not read line by line
+    Lexer(SourceBuffer &Src, const char *Start)
+        : Source(Src), CurPtr(Start), BufEnd(Src.end()), TokStart(CurPtr), IdentifierSym(0), NumVal(0) {}
 
-static int gettok();
+    //return the next token from the source buffer
+    int gettok();
+
+    /// skimToTopLevel - move on to the next 'def'/'extern' token and return its
+    /// byte offset, or the size of the buffer at EOF. Tokens are only told
+    /// apart, not built: nothing is interned, converted or reported. The next
+    /// gettok() returns the keyword. Not for a source read line by line.
+    size_t skimToTopLevel();
+
+    SymbolID getIdentifier() const { return IdentifierSym; }
+    double getNumVal() const { return NumVal; }
+    //getTokenOffset - byte offset of the last token from the start of the
+    //buffer, only meaningful when the source is not read line by line
+    size_t getTokenOffset() const { return TokStart - Source.begin(); }
+};
 
 #endif
\ No newline at end of file
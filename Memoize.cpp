@@ -0,0 +1,134 @@
+#include "Memoize.h"
+#include "AST.h"
+#include "FlatAST.h"
+#include "llvm/Support/MathExtras.h"
+
+MemoTable::MemoTable(SymbolID Name, unsigned NumArgs, uint64_t NumEntries)
+    : Words(llvm::make_unique<std::atomic<uint64_t>[]>(NumEntries * (NumArgs + 2))),
+      NumArgs(NumArgs),
+      Mask(NumEntries - 1),
+      Hits(0),
+      Misses(0),
+      Name(Name) {}
+
+std::atomic<uint64_t> *MemoTable::getEntry(const double *Args) const {
+    uint64_t Hash = 0;
+    for (unsigned I = 0; I != NumArgs; ++I) {
+        Hash = (Hash ^ DoubleToBits(Args[I])) * 0x9e3779b97f4a7c15ULL;
+    }
+    //a multiply only carries differences upwards, and small integers differ in
+    //nothing but the top bits already: fold them down before taking the low bits
+    Hash ^= Hash >> 33;
+    Hash *= 0xff51afd7ed558ccdULL;
+    Hash ^= Hash >> 33;
+    return &Words[(Hash & Mask) * (NumArgs + 2)];
+}
+
+int MemoTable::lookup(MemoTable *Table, const double *Args, double *Result) {
+    std::atomic<uint64_t> *Entry = Table->getEntry(Args);
+    unsigned NumArgs             = Table->NumArgs;
+    uint64_t Seq                 = Entry[0].load(std::memory_order_acquire);
+    bool Hit                     = Seq && !(Seq & 1);
+    for (unsigned I = 0; Hit && I != NumArgs; ++I) {
+        Hit = Entry[I + 1].load(std::memory_order_relaxed) == DoubleToBits(Args[I]);
+    }
+    uint64_t Bits = Entry[NumArgs + 1].load(std::memory_order_relaxed);
+    //what was read is torn if a writer started in the meantime
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!Hit || Entry[0].load(std::memory_order_relaxed) != Seq) {
+        Table->Misses.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    Table->Hits.fetch_add(1, std::memory_order_relaxed);
+    *Result = BitsToDouble(Bits);
+    return 1;
+}
+
+void MemoTable::insert(MemoTable *Table, const double *Args, double Result) {
+    std::atomic<uint64_t> *Entry = Table->getEntry(Args);
+    unsigned NumArgs             = Table->NumArgs;
+    uint64_t Seq                 = Entry[0].load(std::memory_order_relaxed);
+    //another thread is writing the entry, its result is as good as this one
+    if ((Seq & 1) || !Entry[0].compare_exchange_strong(Seq, Seq + 1, std::memory_order_acquire)) {
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    for (unsigned I = 0; I != NumArgs; ++I) {
+        Entry[I + 1].store(DoubleToBits(Args[I]), std::memory_order_relaxed);
+    }
+    Entry[NumArgs + 1].store(DoubleToBits(Result), std::memory_order_relaxed);
+    Entry[0].store(Seq + 2, std::memory_order_release);
+}
+
+//the libm functions whose result only depends on their arguments. They may
+//set errno, which no Kaleidoscope code can read
+static const StringRef PureExterns[] = {
+    "acos", "asin",  "atan", "atan2", "cbrt", "ceil",  "cos",   "cosh", "exp",  "exp2",  "fabs", "floor",
+    "fmax", "fmin",  "fmod", "hypot", "log",  "log10", "log2",  "pow",  "round", "sin", "sinh", "sqrt",
+    "tan",  "tanh",  "trunc",
+};
+
+Memoizer::Memoizer(uint64_t NumEntries) : NumEntries(PowerOf2Ceil(std::max<uint64_t>(1, NumEntries))) {}
+
+bool Memoizer::isPureCallee(SymbolID Self, SymbolID Callee) const {
+    if (Callee == Self || Tables.count(Callee)) {
+        return true;
+    }
+    if (Defined.count(Callee)) {
+        return false;
+    }
+    //an extern, or a definition still to come
+    return is_contained(PureExterns, getSymbolName(Callee));
+}
+
+MemoTable *Memoizer::addDefinition(const FunctionAST &FnAST) {
+    SymbolID Name = FnAST.getProto().getName();
+    //the calls are quickest found in the flat copy
+    std::unique_ptr<FlatFunctionAST> Flat = FnAST.flatten();
+    const FlatAST &Body                   = Flat->getBody();
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    Defined.insert(Name);
+    for (FlatAST::NodeIdx N = 0, E = Body.size(); N != E; ++N) {
+        if (flat_call == Body.getKind(N) && !isPureCallee(Name, Body.getSymbol(N))) {
+            //an earlier definition of the name that failed to compile may have been pure
+            eraseTable(Name);
+            return nullptr;
+        }
+    }
+    std::unique_ptr<MemoTable> &Table = Tables[Name];
+    if (!Table) {
+        Table = llvm::make_unique<MemoTable>(Name, FnAST.getProto().getNumArgs(), NumEntries);
+        Order.push_back(Table.get());
+    }
+    return Table.get();
+}
+
+void Memoizer::eraseTable(SymbolID Name) {
+    auto It = Tables.find(Name);
+    if (It == Tables.end()) {
+        return;
+    }
+    Order.erase(std::find(Order.begin(), Order.end(), It->second.get()));
+    Tables.erase(It);
+}
+
+void Memoizer::removeDefinition(SymbolID Name) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    Defined.erase(Name);
+    eraseTable(Name);
+}
+
+MemoTable *Memoizer::lookup(SymbolID Name) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    auto It = Tables.find(Name);
+    return It == Tables.end() ? nullptr : It->second.get();
+}
+
+void Memoizer::printStats() {
+    std::lock_guard<std::mutex> Guard(Lock);
+    for (MemoTable *Table : Order) {
+        fprintf(stderr, "Memoized %s: %llu hits, %llu misses\n", getSymbolName(Table->getName()).str().c_str(),
+                (unsigned long long)Table->getHits(), (unsigned long long)Table->getMisses());
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef __MEMOIZE_H__
+#define __MEMOIZE_H__
+//===----------------------------------------------------------------------===//
+// Memoization of pure definitions
+//===----------------------------------------------------------------------===//
+// A definition takes doubles and returns a double. If everything it calls is
+// pure as well (itself, other pure definitions or a side-effect free libm
+// function) its result depends on nothing but its arguments. With -memoize
+// such a definition is generated as a wrapper that looks the arguments up in
+// a MemoTable and only runs the body, generated as <name>.body, on a miss.
+// Recursive calls in the body go through the wrapper, so e.g. a naive fib
+// runs its body once per distinct argument.
+#include <atomic>
+#include <mutex>
+#include "AllInclude.h"
+#include "Symbol.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+
+class FunctionAST;
+
+/// MemoTable - a fixed-size, direct-mapped cache of the results of one
+/// function, keyed on the bits of its arguments (so -0.0 and 0.0 or two NaNs
+/// are different keys). Lock-free: each entry has a sequence number that is
+/// odd while the entry is written, readers that see it change miss instead.
+/// A writer that finds the entry busy drops its result, a newer result
+/// replaces an older one of the same slot.
+class MemoTable {
+    //per entry: the sequence number (0 while empty), the argument bits, the result bits
+    std::unique_ptr<std::atomic<uint64_t>[]> Words;
+    const unsigned NumArgs;
+    const uint64_t Mask;
+    std::atomic<uint64_t> Hits, Misses;
+    SymbolID Name;
+
+    std::atomic<uint64_t> *getEntry(const double *Args) const;
+
+   public:
+    //NumEntries is a power of two
+    MemoTable(SymbolID Name, unsigned NumArgs, uint64_t NumEntries);
+
+    SymbolID getName() const { return Name; }
+    uint64_t getHits() const { return Hits; }
+    uint64_t getMisses() const { return Misses; }
+
+    /// lookup/insert - the calls in the wrappers, Args points at the NumArgs
+    /// arguments. lookup returns nonzero and sets *Result on a hit.
+    static int lookup(MemoTable *Table, const double *Args, double *Result);
+    static void insert(MemoTable *Table, const double *Args, double Result);
+};
+
+/// Memoizer - decides which definitions are pure and owns their tables.
+/// Thread safe, a table never moves or goes away once created.
+class Memoizer {
+    std::mutex Lock;
+    //every definition added, and the ones found pure with their tables
+    DenseSet<SymbolID> Defined;
+    DenseMap<SymbolID, std::unique_ptr<MemoTable>> Tables;
+    std::vector<MemoTable *> Order;
+    uint64_t NumEntries;
+
+    bool isPureCallee(SymbolID Self, SymbolID Callee) const;
+    void eraseTable(SymbolID Name);
+
+   public:
+    //every table gets NumEntries entries, rounded up to a power of two
+    explicit Memoizer(uint64_t NumEntries);
+
+    /// addDefinition - decide whether FnAST is pure, before it is generated:
+    /// it may only call itself, definitions added (and found pure) earlier
+    /// and the libm functions without side effects. A definition that calls
+    /// one defined later is taken as impure. Returns its table if it is pure.
+    MemoTable *addDefinition(const FunctionAST &FnAST);
+
+    /// removeDefinition - forget a definition added that failed to compile,
+    /// and its table. Only for one no generated code refers to.
+    void removeDefinition(SymbolID Name);
+
+    /// lookup - the table of Name, null if it is not a pure definition
+    MemoTable *lookup(SymbolID Name);
+
+    /// printStats - the hits and misses of every table, in definition order
+    void printStats();
+};
+
+#endif
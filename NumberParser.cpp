@@ -0,0 +1,188 @@
+#include "NumberParser.h"
+#include <cstdint>
+#include <cstring>
+#include "llvm/ADT/StringRef.h"
+
+namespace {
+
+const uint64_t Pow5Table[][2] = {
+#include "Pow5Table.inc"
+};
+const int SmallestPow5 = -342;
+const int LargestPow5  = 308;
+
+//10^q is exact in a double up to 10^22
+const double ExactPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                             1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                             1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// IEEE double layout
+const int MantissaBits  = 52;
+const int MinExponent   = -1023;
+const int InfinitePower = 0x7ff;
+
+/// Decimal - the literal as W * 10^Q, W holds the first 19 significant digits
+struct Decimal {
+    uint64_t W;
+    int64_t Q;
+    //digits were dropped after the 19th
+    bool Truncated;
+};
+
+/// scanDecimal - split [P, End) into a Decimal, false if it is not
+/// digits with at most one '.' and at least one digit
+bool scanDecimal(const char *P, const char *End, Decimal &D) {
+    D.W         = 0;
+    D.Q         = 0;
+    D.Truncated = false;
+    int Digits  = 0;  // significant digits seen
+    bool SeenDot = false, SeenDigit = false;
+
+    for (; P != End; ++P) {
+        if ('.' == *P) {
+            if (SeenDot) {
+                return false;
+            }
+            SeenDot = true;
+            continue;
+        }
+        if (*P < '0' || *P > '9') {
+            return false;
+        }
+        SeenDigit = true;
+
+        unsigned Digit = *P - '0';
+        //leading zeros are not significant, but after the '.' they still scale
+        if (0 == Digits && 0 == Digit) {
+            D.Q -= SeenDot;
+            continue;
+        }
+        if (Digits < 19) {
+            D.W = D.W * 10 + Digit;
+            D.Q -= SeenDot;
+            ++Digits;
+        } else {
+            //too many digits to hold, the ones before the '.' still count for the magnitude
+            D.Truncated |= 0 != Digit;
+            D.Q += !SeenDot;
+        }
+    }
+    return SeenDigit;
+}
+
+/// makeDouble - assemble the bits; Power2 is the biased exponent
+double makeDouble(uint64_t Mantissa, int Power2) {
+    uint64_t Bits = Mantissa | (uint64_t)Power2 << MantissaBits;
+    double Result;
+    memcpy(&Result, &Bits, sizeof(Result));
+    return Result;
+}
+
+/// eiselLemire - round W * 10^Q (W != 0) to a double as mantissa and biased
+/// exponent. W is exact, so the 128-bit product is always enough to round
+/// correctly (Mushtak & Lemire, "Fast Number Parsing Without Fallback").
+void eiselLemire(int64_t Q, uint64_t W, uint64_t &Mantissa, int &Power2) {
+    if (Q < SmallestPow5) {
+        Mantissa = 0;
+        Power2   = 0;
+        return;
+    }
+    if (Q > LargestPow5) {
+        Mantissa = 0;
+        Power2   = InfinitePower;
+        return;
+    }
+
+    //normalize W so its top bit is set
+    int LZ = __builtin_clzll(W);
+    W <<= LZ;
+
+    //multiply by the truncated 5^Q, take the second word only when the
+    //first one can not decide the rounding
+    const uint64_t *Pow5 = Pow5Table[Q - SmallestPow5];
+    unsigned __int128 First = (unsigned __int128)W * Pow5[0];
+    uint64_t High = (uint64_t)(First >> 64), Low = (uint64_t)First;
+    const uint64_t PrecisionMask = ~0ULL >> (MantissaBits + 3);
+    if ((High & PrecisionMask) == PrecisionMask) {
+        uint64_t SecondHigh = (uint64_t)(((unsigned __int128)W * Pow5[1]) >> 64);
+        Low += SecondHigh;
+        if (SecondHigh > Low) {
+            ++High;
+        }
+    }
+
+    int UpperBit = (int)(High >> 63);
+    Mantissa     = High >> (UpperBit + 64 - MantissaBits - 3);
+    // floor(log2(10^Q)) + 63, the product of the exponent of 10^Q and the shift
+    Power2 = (int)((((152170 + 65536) * Q) >> 16) + 63) + UpperBit - LZ - MinExponent;
+
+    if (Power2 <= 0) {
+        //subnormal, or zero
+        if (-Power2 + 1 >= 64) {
+            Mantissa = 0;
+            Power2   = 0;
+            return;
+        }
+        Mantissa >>= -Power2 + 1;
+        Mantissa += Mantissa & 1;
+        Mantissa >>= 1;
+        //rounding may have carried into the smallest normal
+        Power2 = Mantissa < (1ULL << MantissaBits) ? 0 : 1;
+        return;
+    }
+
+    //exactly halfway between two doubles: round to even. Only possible for small Q.
+    if (Low <= 1 && Q >= -4 && Q <= 23 && 1 == (Mantissa & 3)) {
+        if ((Mantissa << (UpperBit + 64 - MantissaBits - 3)) == High) {
+            Mantissa &= ~1ULL;
+        }
+    }
+
+    Mantissa += Mantissa & 1;
+    Mantissa >>= 1;
+    if (Mantissa >= (2ULL << MantissaBits)) {
+        Mantissa = 1ULL << MantissaBits;
+        ++Power2;
+    }
+    Mantissa &= ~(1ULL << MantissaBits);
+    if (Power2 >= InfinitePower) {
+        Mantissa = 0;
+        Power2   = InfinitePower;
+    }
+}
+
+}  // end anonymous namespace
+
+bool parseNumber(const char *Begin, const char *End, double &Result) {
+    Decimal D;
+    if (!scanDecimal(Begin, End, D)) {
+        return false;
+    }
+
+    if (0 == D.W) {
+        Result = 0;
+        return true;
+    }
+
+    //Clinger: both W and 10^Q are exact doubles, one rounding in the multiply or divide
+    if (!D.Truncated && D.Q >= -22 && D.Q <= 22 && D.W <= (1ULL << 53)) {
+        Result = D.Q < 0 ? (double)D.W / ExactPow10[-D.Q] : (double)D.W * ExactPow10[D.Q];
+        return true;
+    }
+
+    uint64_t Mantissa;
+    int Power2;
+    eiselLemire(D.Q, D.W, Mantissa, Power2);
+    if (D.Truncated) {
+        //the exact value lies between W and W+1, if both round the same way we are done
+        uint64_t UpMantissa;
+        int UpPower2;
+        eiselLemire(D.Q, D.W + 1, UpMantissa, UpPower2);
+        if (UpMantissa != Mantissa || UpPower2 != Power2) {
+            //rare: fall back to APFloat's exact (and locale independent) conversion
+            return !llvm::StringRef(Begin, End - Begin).getAsDouble(Result);
+        }
+    }
+    Result = makeDouble(Mantissa, Power2);
+    return true;
+}
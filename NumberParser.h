@@ -0,0 +1,18 @@
+#ifndef __NUMBERPARSER_H__
+#define __NUMBERPARSER_H__
+//===----------------------------------------------------------------------===//
+// Number literal parser
+//===----------------------------------------------------------------------===//
+
+/// parseNumber - convert the literal in [Begin, End) to the nearest double
+/// (round half to even, same result as a correct strtod). A literal is
+/// digits with at most one '.', like "12", "1.5", ".5" or "5.". Returns false
+/// for anything else, e.g. "1.2.3" or ".".
+///
+/// Works in place on the source bytes, does not allocate and does not depend
+/// on the locale. Up to 19 significant digits are converted with Clinger's
+/// fast path or the Eisel-Lemire algorithm, only longer literals that fall
+/// right between two doubles take the slow exact path.
+bool parseNumber(const char *Begin, const char *End, double &Result);
+
+#endif
@@ -0,0 +1,75 @@
+#include "Optimize.h"
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Target/TargetMachine.h"
+
+void optimizeModule(Module &M, OptLevel Level, TargetMachine *TM) {
+    //buildPerModuleDefaultPipeline wants some optimization
+    if (opt_O0 == Level) {
+        return;
+    }
+
+    PassBuilder PB(TM);
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+    static const PassBuilder::OptimizationLevel Levels[] = {
+        PassBuilder::OptimizationLevel::O0, PassBuilder::OptimizationLevel::O1,
+        PassBuilder::OptimizationLevel::O2, PassBuilder::OptimizationLevel::O3};
+    ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(Levels[Level]);
+    MPM.run(M, MAM);
+}
+
+std::unique_ptr<TargetMachine> cloneTargetMachine(const TargetMachine &TM) {
+    SmallVector<StringRef, 64> Features;
+    TM.getTargetFeatureString().split(Features, ',', -1, false);
+    std::vector<std::string> Attrs(Features.begin(), Features.end());
+    return std::unique_ptr<TargetMachine>(EngineBuilder()
+                                              .setMCPU(TM.getTargetCPU())
+                                              .setMAttrs(Attrs)
+                                              .setTargetOptions(TM.Options)
+                                              .setOptLevel(TM.getOptLevel())
+                                              .selectTarget());
+}
+
+CodeGenOpt::Level getCodeGenOptLevel(OptLevel Level) {
+    switch (Level) {
+        case opt_O0:
+            return CodeGenOpt::None;
+        case opt_O1:
+            return CodeGenOpt::Less;
+        case opt_O2:
+            return CodeGenOpt::Default;
+        case opt_O3:
+            return CodeGenOpt::Aggressive;
+    }
+    llvm_unreachable("unknown optimization level");
+}
+
+FastMathFlags getFastMathFlags(FPMode Mode) {
+    FastMathFlags FMF;
+    switch (Mode) {
+        case fp_strict:
+            break;
+        case fp_contract:
+            FMF.setAllowContract();
+            break;
+        case fp_fast:
+            FMF.setFast();
+            break;
+    }
+    return FMF;
+}
+
+void setFPOptions(TargetMachine &TM, FPMode Mode) {
+    //the unsafe/no-NaNs/no-infs/no-signed-zeros options are reset from the
+    //attributes of each function, codegen puts those on (addFPAttributes)
+    TM.Options.AllowFPOpFusion = fp_strict == Mode ? FPOpFusion::Standard : FPOpFusion::Fast;
+}
\ No newline at end of file
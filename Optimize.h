@@ -0,0 +1,51 @@
+#ifndef __OPTIMIZE_H__
+#define __OPTIMIZE_H__
+//===----------------------------------------------------------------------===//
+// Optimization pipelines
+//===----------------------------------------------------------------------===//
+#include "AllInclude.h"
+#include "llvm/Support/CodeGen.h"
+
+namespace llvm {
+class TargetMachine;
+}
+
+enum OptLevel {
+    opt_O0 = 0,
+    opt_O1 = 1,
+    opt_O2 = 2,
+    opt_O3 = 3,
+};
+
+/// optimizeModule - run the new pass manager's default per-module pipeline
+/// for Level over M, the one opt runs for -passes='default<O2>' and so on.
+/// Every level inlines and runs the interprocedural passes (GlobalOpt,
+/// IPSCCP); the higher ones inline more and add more and costlier function
+/// and loop passes. -O0 runs nothing. TM, if given, supplies the target's cost model; a TargetMachine
+/// must not be shared by threads optimizing at the same time.
+void optimizeModule(Module &M, OptLevel Level, TargetMachine *TM);
+
+/// cloneTargetMachine - a TargetMachine for the CPU, features and options of
+/// TM, for a thread that must not share TM
+std::unique_ptr<TargetMachine> cloneTargetMachine(const TargetMachine &TM);
+
+/// getCodeGenOptLevel - the instruction selection level to go with Level, -O0
+/// selects with FastISel
+CodeGenOpt::Level getCodeGenOptLevel(OptLevel Level);
+
+/// FPMode - how freely floating point arithmetic may be rewritten
+enum FPMode {
+    fp_strict   = 0,  // IEEE semantics, the default
+    fp_contract = 1,  // a * b + c may become one fused multiply-add
+    fp_fast     = 2,  // also reassociate and assume no NaNs, infinities or signed zeros
+};
+
+/// getFastMathFlags - the flags codegen puts on the arithmetic of Mode
+FastMathFlags getFastMathFlags(FPMode Mode);
+
+/// setFPOptions - make TM's instruction selection agree with Mode, so that
+/// contracted a * b + c is emitted as an FMA where the CPU has one. The rest
+/// of fp_fast reaches instruction selection through function attributes.
+void setFPOptions(TargetMachine &TM, FPMode Mode);
+
+#endif
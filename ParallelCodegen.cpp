@@ -0,0 +1,56 @@
+#include "ParallelCodegen.h"
+#include <thread>
+
+//fewer definitions per thread are not worth a context of their own
+static const size_t MinDefsPerThread = 64;
+
+static void compileRange(CodegenContext &CG, ArrayRef<FunctionAST *> Defs, DefinitionEmitter Emit,
+                         ModuleFinisher Finish, MutableArrayRef<Function *> Functions) {
+    for (size_t I = 0, E = Defs.size(); I != E; ++I) {
+        Functions[I] = Emit(CG, *Defs[I]);
+    }
+    if (Finish) {
+        Finish(CG);
+    }
+}
+
+std::vector<std::unique_ptr<CodegenContext>> compileInParallel(ArrayRef<FunctionAST *> Defs,
+                                                               const FunctionProtoMap &Protos,
+                                                               const DataLayout &DL, FastMathFlags FMF,
+                                                               unsigned NumThreads,
+                                                               DefinitionEmitter Emit, ModuleFinisher Finish,
+                                                               std::vector<Function *> &Functions) {
+    if (0 == NumThreads) {
+        NumThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t NumRanges = std::max<size_t>(1, std::min<size_t>(NumThreads, Defs.size() / MinDefsPerThread));
+
+    std::vector<std::unique_ptr<CodegenContext>> Contexts;
+    for (size_t I = 0; I != NumRanges; ++I) {
+        Contexts.push_back(llvm::make_unique<CodegenContext>("my first coder", &Protos));
+        Contexts.back()->getModule().setDataLayout(DL);
+        Contexts.back()->setFastMathFlags(FMF);
+    }
+
+    //range I is [Starts[I], Starts[I + 1])
+    Functions.assign(Defs.size(), nullptr);
+    std::vector<size_t> Starts;
+    for (size_t I = 0; I <= NumRanges; ++I) {
+        Starts.push_back(Defs.size() * I / NumRanges);
+    }
+    auto Run = [&](size_t I) {
+        size_t Begin = Starts[I], Len = Starts[I + 1] - Starts[I];
+        compileRange(*Contexts[I], Defs.slice(Begin, Len), Emit, Finish,
+                     MutableArrayRef<Function *>(Functions).slice(Begin, Len));
+    };
+
+    std::vector<std::thread> Workers;
+    for (size_t I = 1; I < NumRanges; ++I) {
+        Workers.emplace_back(Run, I);
+    }
+    Run(0);
+    for (auto &W : Workers) {
+        W.join();
+    }
+    return Contexts;
+}
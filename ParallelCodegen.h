@@ -0,0 +1,33 @@
+#ifndef __PARALLELCODEGEN_H__
+#define __PARALLELCODEGEN_H__
+//===----------------------------------------------------------------------===//
+// Parallel code generation
+//===----------------------------------------------------------------------===//
+#include "AST.h"
+#include "AllInclude.h"
+#include "Codegen.h"
+
+typedef function_ref<Function *(CodegenContext &, FunctionAST &)> DefinitionEmitter;
+typedef function_ref<void(CodegenContext &)> ModuleFinisher;
+
+/// compileInParallel - generate code for Defs on NumThreads threads (0 means
+/// one per core) and return the contexts they generated into, one per thread.
+/// Each thread has its own LLVMContext and module and takes a contiguous run of
+/// Defs, so the split only depends on the number of threads. Calls between
+/// functions are generated against declarations made from Protos, which must
+/// hold the prototype of every function the definitions call or define; it is
+/// only read. The modules get the data layout DL and the arithmetic the
+/// fast-math flags FMF.
+/// Emit generates one definition and Finish, if given, completes a module
+/// once its definitions are done (e.g. optimizes it); both are called on the
+/// worker threads. Functions[I] is what Emit returned for Defs[I], null if it
+/// failed; Finish may delete or inline away functions, so the pointers are only
+/// good for telling the failures.
+std::vector<std::unique_ptr<CodegenContext>> compileInParallel(ArrayRef<FunctionAST *> Defs,
+                                                               const FunctionProtoMap &Protos,
+                                                               const DataLayout &DL, FastMathFlags FMF,
+                                                               unsigned NumThreads,
+                                                               DefinitionEmitter Emit, ModuleFinisher Finish,
+                                                               std::vector<Function *> &Functions);
+
+#endif
@@ -0,0 +1,93 @@
+#include "ParallelParser.h"
+#include <cassert>
+#include <cstring>
+#include <thread>
+#include "Lexer.h"
+#include "Parser.h"
+#include "TokenBuffer.h"
+
+//smaller inputs are not worth another thread
+static const size_t MinChunkSize = 64 * 1024;
+
+/// parseChunk - parse the items that start in [Begin, End). Begin is a line
+/// start, so it is a token boundary for any lexer that got there. The tokens
+/// before the first 'def'/'extern' belong to the previous chunk's last item:
+/// they are only skimmed, their errors are the previous chunk's to report.
+static void parseChunk(SourceBuffer &Source, const char *Begin, const char *End, bool First,
+                       std::vector<TopLevelItem> &Items) {
+    Lexer Lex(Source, Begin);
+    if (!First) {
+        Lex.skimToTopLevel();
+    }
+    TokenBuffer Toks;
+    Toks.tokenize(Lex, End - Source.begin());
+
+    Parser P(Toks);
+    P.getNextToken();
+    parseTopLevelItems(P, Items);
+}
+
+void parseTopLevelItems(Parser &P, std::vector<TopLevelItem> &Items) {
+    while (1) {
+        TopLevelItem Item;
+        switch (P.getCurTok()) {
+            case tok_eof:
+                return;
+            case ';':  //ignore top-level semicolons
+                P.getNextToken();
+                continue;
+            case tok_def:
+                Item.Kind     = TopLevelItem::Definition;
+                Item.Function = P.ParseDefinition();
+                break;
+            case tok_extern:
+                Item.Kind  = TopLevelItem::Extern;
+                Item.Proto = P.ParseExtern();
+                break;
+            default:
+                Item.Kind     = TopLevelItem::Expression;
+                Item.Function = P.ParseTopLevelExpr();
+                break;
+        }
+
+        if (Item.Function || Item.Proto) {
+            Items.push_back(std::move(Item));
+        } else {
+            P.skipToNextTopLevel();
+        }
+    }
+}
+
+std::vector<TopLevelItem> parseTopLevelItems(SourceBuffer &Source, unsigned NumThreads) {
+    assert(!Source.isInteractive() && "a terminal is parsed one line at a time");
+    if (0 == NumThreads) {
+        NumThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t Size      = Source.end() - Source.begin();
+    size_t NumChunks = std::min<size_t>(NumThreads, Size / MinChunkSize + 1);
+
+    //chunk I is [Starts[I], Starts[I + 1]), each cut moved on to a line start
+    std::vector<const char *> Starts(1, Source.begin());
+    for (size_t I = 1; I < NumChunks; ++I) {
+        const char *Cut = std::max(Source.begin() + Size * I / NumChunks, Starts.back());
+        const char *NL  = (const char *)memchr(Cut, '\n', Source.end() - Cut);
+        Starts.push_back(NL ? NL + 1 : Source.end());
+    }
+    Starts.push_back(Source.end());
+
+    std::vector<std::vector<TopLevelItem>> ChunkItems(NumChunks);
+    std::vector<std::thread> Workers;
+    for (size_t I = 1; I < NumChunks; ++I) {
+        Workers.emplace_back(parseChunk, std::ref(Source), Starts[I], Starts[I + 1], false, std::ref(ChunkItems[I]));
+    }
+    parseChunk(Source, Starts[0], Starts[1], true, ChunkItems[0]);
+    for (auto &W : Workers) {
+        W.join();
+    }
+
+    std::vector<TopLevelItem> Items;
+    for (auto &Chunk : ChunkItems) {
+        std::move(Chunk.begin(), Chunk.end(), std::back_inserter(Items));
+    }
+    return Items;
+}
@@ -0,0 +1,35 @@
+#ifndef __PARALLELPARSER_H__
+#define __PARALLELPARSER_H__
+//===----------------------------------------------------------------------===//
+// Parallel parsing of a whole source
+//===----------------------------------------------------------------------===//
+#include "AST.h"
+#include "AllInclude.h"
+#include "SourceBuffer.h"
+
+class Parser;
+
+/// TopLevelItem - one successfully parsed top-level item
+struct TopLevelItem {
+    enum ItemKind { Definition, Extern, Expression } Kind;
+    //the definition or top-level expression
+    std::unique_ptr<FunctionAST> Function;
+    //the extern
+    std::unique_ptr<PrototypeAST> Proto;
+};
+
+/// parseTopLevelItems - parse every item P has left onto Items, skipping the
+/// ones with syntax errors. The same dispatch as MainLoop in toy.cpp.
+void parseTopLevelItems(Parser &P, std::vector<TopLevelItem> &Items);
+
+/// parseTopLevelItems - parse all of Source on NumThreads threads (0 means one
+/// per core) and return its items in source order.
+/// Every 'def'/'extern' starts a new item, so the text is cut into one chunk per
+/// thread at line starts and each chunk parses the items that begin inside it,
+/// lexing on past its end to finish the last one. Items come out as with
+/// -pretokenize: after a syntax error parsing resumes at the next 'def'/'extern'.
+/// Errors are reported as each thread finds them, not in source order.
+/// Source must not be interactive.
+std::vector<TopLevelItem> parseTopLevelItems(SourceBuffer &Source, unsigned NumThreads);
+
+#endif
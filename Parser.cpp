@@ -4,102 +4,52 @@
 #include "Parser.h"
 #include "Error.h"
 
+Parser::Parser(Lexer *Lex, const TokenBuffer *Toks)
+    : Lex(Lex), Toks(Toks), TokIdx(0), CurTok(0), CurIdentifier(0), CurNumVal(0), Arena(nullptr) {
+    std::fill(std::begin(BinopPrecedence), std::end(BinopPrecedence), 0);
+    // Install standard binary operators
+    // 1 is lowest precedence
+    BinopPrecedence['<'] = 10;
+    BinopPrecedence['+'] = 20;
+    BinopPrecedence['-'] = 20;
+    BinopPrecedence['*'] = 40;  //hihest
+}
+
 /// CurTok/getNextToken - Provide a simple token buffer.  CurTok is the current
 /// token the parser is looking at.  getNextToken reads another token from the
 /// lexer and updates CurTok with its results.
-static int getNextToken() {
-    return CurTok = gettok();
-}
-
-///numberExpr ::= number;  token is tok_number,it will create NumberExprAST node.
-static std::unique_ptr<ExprAST> ParseNumberExpr() {
-    auto Result = llvm::make_unique<NumberExprAST>(NumVal);
-    getNextToken();  // consumber the number
-    return std::move(Result);
-}
-
-/// expression ::= primary binoprhs
-///  an expression is a primary expression potentially followed by a sequence of [binop,primaryexpr] pairs:
-static std::unique_ptr<ExprAST> ParseExpression() {
-    auto LHS = ParsePrimary();
-    if (!LHS) {
-        return nullptr;
-    }
-
-    return ParseBinOpRHS(0, std::move(LHS));
-}
-
-//parenexpr := '(' expression ')'
-static std::unique_ptr<ExprAST> ParseParenExpr() {
-    getNextToken();  //eat '('
-    auto V = ParseExpression();
-    if (!V) {
-        return nullptr;
+int Parser::getNextToken() {
+    if (!Toks) {
+        CurTok        = Lex->gettok();
+        CurIdentifier = Lex->getIdentifier();
+        CurNumVal     = Lex->getNumVal();
+        return CurTok;
     }
 
-    if (CurTok != ')') {
-        return LogError("expected ')'");
+    //stay on the final tok_eof
+    size_t Idx = TokIdx < Toks->size() ? TokIdx++ : Toks->size() - 1;
+    CurTok     = Toks->getKind(Idx);
+    if (tok_identifier == CurTok) {
+        CurIdentifier = Toks->getIdentifier(Idx);
+    } else if (tok_number == CurTok) {
+        CurNumVal = Toks->getNumVal(Idx);
     }
-    getNextToken();  //eat ')'
-    return V;
+    return CurTok;
 }
 
-/// identifierexpr
-/// ::= identifier
-/// ::= identifier '(' expression* ')'
-/// It handles this by checking to see if the token after the identifier is a ‘(‘ token, constructing either a VariableExprAST or CallExprAST node as appropriate.
-static std::unique_ptr<ExprAST> ParseIdentifierExpr() {
-    std::string IdName = IdentifierStr;
-    getNextToken();       //eat identifier
-    if ('(' != CurTok) {  // simple variable ref
-        return llvm::make_unique<VariableExprAST>(IdName);
+void Parser::skipToNextTopLevel() {
+    if (!Toks) {
+        getNextToken();
+        return;
     }
 
-    /// call function
+    //TokIdx - 1 is CurTok, if that already starts the next item stay there
+    TokIdx = Toks->getNextTopLevel(TokIdx ? TokIdx - 1 : 0);
     getNextToken();
-    std::vector<std::unique_ptr<ExprAST>> Args;
-    if (')' != CurTok) {
-        while (1) {
-            if (auto Arg = ParseExpression()) {
-                Args.push_back(std::move(Arg));
-            } else {
-                return nullptr;
-            }
-
-            if (')' == CurTok) {
-                break;
-            }
-            //func(a, b, c)
-            if (',' != CurTok) {
-                return LogError("Expected ')' or ',' in argument list");
-            }
-            getNextToken();
-        }
-    }
-    getNextToken();  //Eat the ')'
-
-    return llvm::make_unique<CallExprAST>(IdName, std::move(Args));
-}
-
-/// primary
-/// ::= identifierexpr
-/// ::= numberexpr
-/// ::= parenexpr
-static std::unique_ptr<ExprAST> ParsePrimary() {
-    switch (CurTok) {
-        default:
-            return LogError("unknow token when expecting an expression");
-        case tok_identifier:
-            return ParseIdentifierExpr();
-        case tok_number:
-            return ParseNumberExpr();
-        case '(':
-            return ParseParenExpr();
-    }
 }
 
-static int GetTokPrecedence() {
-    if (!isascii(CurTok)) {
+int Parser::GetTokPrecedence() {
+    if (CurTok < 0 || CurTok > 255) {
         return -1;
     }
 
@@ -112,52 +62,194 @@ static int GetTokPrecedence() {
     return TokPrec;
 }
 
-/// binoprhs ::= ('+' primary)*
-static std::unique_ptr<ExprAST> ParseBinOpRHS(int ExprPrec, std::unique_ptr<ExprAST> LHS) {
-    // if this is a binop, find its precedence.
+void Parser::ReduceOps(size_t OpBase, int MinPrec) {
+    while (OpStack.size() > OpBase && OpStack.back().Prec >= MinPrec) {
+        char Op = OpStack.back().Op;
+        OpStack.pop_back();
+        ExprAST *RHS = ValStack.back();
+        ValStack.pop_back();
+        //Merge LHS/RHS
+        ValStack.back() = Arena->create<BinaryExprAST>(Op, ValStack.back(), RHS);
+    }
+}
+
+ExprAST *Parser::ParseExpression() {
+    ValStack.clear();
+    OpStack.clear();
+    FrameStack.clear();
+    ExprFrame Top = {ExprFrame::TopLevel, 0, 0, 0};
+    FrameStack.push_back(Top);
+
     while (1) {
-        //CurTok is a binary operator
-        int TokPrec = GetTokPrecedence();
+        //expect a primary
+        switch (CurTok) {
+            default:
+                return LogError("unknow token when expecting an expression");
+            case tok_error:  //already reported by the lexer
+                return nullptr;
+            case tok_number:
+                ValStack.push_back(Arena->create<NumberExprAST>(CurNumVal));
+                getNextToken();  // consumber the number
+                break;
+            case '(': {
+                getNextToken();  //eat '('
+                ExprFrame Paren = {ExprFrame::Paren, OpStack.size(), 0, 0};
+                FrameStack.push_back(Paren);
+                continue;
+            }
+            case tok_identifier: {
+                SymbolID IdName = CurIdentifier;
+                getNextToken();       //eat identifier
+                if ('(' != CurTok) {  // simple variable ref
+                    ValStack.push_back(Arena->create<VariableExprAST>(IdName));
+                    break;
+                }
 
-        // if this is a binop that binds at lease as tightly as the current binop consume it , otherwise we are done
-        if (TokPrec < ExprPrec) {
-            return LHS;
+                /// call function
+                getNextToken();
+                if (')' == CurTok) {
+                    getNextToken();  //Eat the ')'
+                    ValStack.push_back(Arena->create<CallExprAST>(IdName, MutableArrayRef<ExprAST *>()));
+                    break;
+                }
+                //the arguments are parsed as nested expressions
+                ExprFrame Call = {ExprFrame::Call, OpStack.size(), IdName, ValStack.size()};
+                FrameStack.push_back(Call);
+                continue;
+            }
+            case tok_if: {
+                getNextToken();  //eat 'if'
+                ExprFrame If = {ExprFrame::IfCond, OpStack.size(), 0, ValStack.size()};
+                FrameStack.push_back(If);
+                continue;
+            }
+            case tok_for: {
+                getNextToken();  //eat 'for'
+                if (tok_identifier != CurTok) {
+                    return LogError("expected identifier after for");
+                }
+                SymbolID VarName = CurIdentifier;
+                getNextToken();  //eat identifier
+                if ('=' != CurTok) {
+                    return LogError("expected '=' after for");
+                }
+                getNextToken();  //eat '='
+                ExprFrame For = {ExprFrame::ForStart, OpStack.size(), VarName, ValStack.size()};
+                FrameStack.push_back(For);
+                continue;
+            }
         }
 
-        // Okay, we know this is a binop
-        int BinOp = CurTok;
-        getNextToken();  //eat binop
+        //an operand is complete: take a binary operator, or close frames until one is expected
+        while (1) {
+            ExprFrame &F = FrameStack.back();
+            int TokPrec  = GetTokPrecedence();
+            if (TokPrec > 0) {
+                //everything pending that binds at least as tightly becomes the LHS
+                ReduceOps(F.OpBase, TokPrec);
+                PendingOp Op = {(char)CurTok, TokPrec};
+                OpStack.push_back(Op);
+                getNextToken();  //eat binop
+                break;
+            }
+
+            //no operator follows, the expression of this frame is done
+            ReduceOps(F.OpBase, 0);
+            if (ExprFrame::TopLevel == F.Kind) {
+                return ValStack.back();
+            }
 
-        // parse the primary expression after the binary operator
-        // （a + b）binop unparsed ; a + ( b binop unparsed)
-        auto RHS = ParsePrimary();
-        if (!RHS) {
-            return nullptr;
-        }
+            if (ExprFrame::Paren == F.Kind) {
+                if (CurTok != ')') {
+                    return LogError("expected ')'");
+                }
+                getNextToken();  //eat ')'
+                FrameStack.pop_back();
+                continue;
+            }
 
-        // If BinOp binds less tightly with RHS than the operator after RHS, let
-        // the pending operator take RHS as its LHS.
-        int NextPrec = GetTokPrecedence();
-        if (TokPrec < NextPrec) {
-            //we recursively invoke the ParseBinOpRHS function specifying “TokPrec+1” as the minimum precedence required for it to continue.
-            RHS = ParseBinOpRHS(TokPrec + 1, std::move(RHS));
-            if (!RHS) {
-                return nullptr;
+            //the next part of an if or for follows its keyword
+            if (ExprFrame::IfCond == F.Kind) {
+                if (tok_then != CurTok) {
+                    return LogError("expected then");
+                }
+                getNextToken();  //eat 'then'
+                F.Kind = ExprFrame::IfThen;
+                break;
             }
+            if (ExprFrame::IfThen == F.Kind) {
+                if (tok_else != CurTok) {
+                    return LogError("expected else");
+                }
+                getNextToken();  //eat 'else'
+                F.Kind = ExprFrame::IfElse;
+                break;
+            }
+            if (ExprFrame::ForStart == F.Kind) {
+                if (',' != CurTok) {
+                    return LogError("expected ',' after for start value");
+                }
+                getNextToken();  //eat ','
+                F.Kind = ExprFrame::ForEnd;
+                break;
+            }
+            if (ExprFrame::ForEnd == F.Kind && ',' == CurTok) {
+                getNextToken();  //eat ','
+                F.Kind = ExprFrame::ForStep;
+                break;
+            }
+            if (ExprFrame::ForEnd == F.Kind || ExprFrame::ForStep == F.Kind) {
+                if (tok_in != CurTok) {
+                    return LogError("expected 'in' after for");
+                }
+                getNextToken();  //eat 'in'
+                if (ExprFrame::ForEnd == F.Kind) {
+                    ValStack.push_back(Arena->create<NumberExprAST>(1.0));
+                }
+                F.Kind = ExprFrame::ForBody;
+                break;
+            }
+            if (ExprFrame::IfElse == F.Kind || ExprFrame::ForBody == F.Kind) {
+                ExprAST **Parts = ValStack.data() + F.OperandBase;
+                ExprAST *E;
+                if (ExprFrame::IfElse == F.Kind) {
+                    E = Arena->create<IfExprAST>(Parts[0], Parts[1], Parts[2]);
+                } else {
+                    E = Arena->create<ForExprAST>(F.Name, Parts[0], Parts[1], Parts[2], Parts[3]);
+                }
+                ValStack.resize(F.OperandBase);
+                ValStack.push_back(E);
+                FrameStack.pop_back();
+                continue;
+            }
+
+            //call argument; func(a, b, c)
+            if (',' == CurTok) {
+                getNextToken();
+                F.OpBase = OpStack.size();
+                break;
+            }
+            if (')' != CurTok) {
+                return LogError("Expected ')' or ',' in argument list");
+            }
+            getNextToken();  //Eat the ')'
+            ArrayRef<ExprAST *> Args(ValStack.data() + F.OperandBase, ValStack.size() - F.OperandBase);
+            ExprAST *Call = Arena->create<CallExprAST>(F.Name, Arena->copyArray<ExprAST *>(Args));
+            ValStack.resize(F.OperandBase);
+            ValStack.push_back(Call);
+            FrameStack.pop_back();
         }
-        //Merge LHS/RHS
-        LHS = llvm::make_unique<BinaryExprAST>(BinOp, std::move(LHS), std::move(RHS));
-    }  // loop around to the top of the while loop
+    }
 }
 
 /// prototype ::= id '(' id* ')' ;The next thing missing is handling of function prototypes.
 /// function prototypes : id(id id id)
-static std::unique_ptr<PrototypeAST> ParsePrototype() {
+std::unique_ptr<PrototypeAST> Parser::ParsePrototype() {
     if (tok_identifier != CurTok) {
         return LogErrorP("Expected function name in prototype");
     }
 
-    std::string FnName = IdentifierStr;
+    SymbolID FnName = CurIdentifier;
     getNextToken();
 
     if ('(' != CurTok) {
@@ -165,9 +257,9 @@ static std::unique_ptr<PrototypeAST> ParsePrototype() {
     }
 
     //read the list of argument names.
-    std::vector<std::string> ArgNames;
+    std::vector<SymbolID> ArgNames;
     while (tok_identifier == getNextToken()) {
-        ArgNames.push_back(IdentifierStr);
+        ArgNames.push_back(CurIdentifier);
     }
     if (')' != CurTok) {
         return LogErrorP("Expected ')' in prototype");
@@ -180,31 +272,37 @@ static std::unique_ptr<PrototypeAST> ParsePrototype() {
 }
 
 //definition ::= 'def' prototype expression
-static std::unique_ptr<FunctionAST> ParseDefinition() {
+std::unique_ptr<FunctionAST> Parser::ParseDefinition() {
     getNextToken();  //eat def
     auto Proto = ParsePrototype();
     if (!Proto) {
         return nullptr;
     }
 
+    //the body goes into a fresh arena that the FunctionAST takes over, on an
+    //error the partial tree is dropped with it
+    auto BodyArena = llvm::make_unique<ASTArena>();
+    Arena          = BodyArena.get();
     if (auto E = ParseExpression()) {
-        return llvm::make_unique<FunctionAST>(std::move(Proto), std::move(E));
+        return llvm::make_unique<FunctionAST>(std::move(BodyArena), std::move(Proto), E);
     }
     return nullptr;
 }
 
 /// In addition, we support ‘extern’ to declare functions like ‘sin’ and ‘cos’ as well as to support forward declaration of user functions. These ‘extern’s are just prototypes with no body:
-static std::unique_ptr<PrototypeAST> ParseExtern() {
+std::unique_ptr<PrototypeAST> Parser::ParseExtern() {
     getNextToken();  //eat extern
     return ParsePrototype();
 }
 
 /// toplevelexpr ::= expression
-static std::unique_ptr<FunctionAST> ParseTopLevelExpr() {
+std::unique_ptr<FunctionAST> Parser::ParseTopLevelExpr() {
+    auto BodyArena = llvm::make_unique<ASTArena>();
+    Arena          = BodyArena.get();
     if (auto E = ParseExpression()) {
         //make an anonymous proto
-        auto Proto = llvm::make_unique<PrototypeAST>("", std::vector<std::string>());
-        return llvm::make_unique<FunctionAST>(std::move(Proto), std::move(E));
+        auto Proto = llvm::make_unique<PrototypeAST>(sym_anon, std::vector<SymbolID>());
+        return llvm::make_unique<FunctionAST>(std::move(BodyArena), std::move(Proto), E);
     }
     return nullptr;
 }
\ No newline at end of file
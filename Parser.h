@@ -3,53 +3,106 @@
 #include "AST.h"
 #include "AllInclude.h"
 #include "Lexer.h"
-/// CurTok/getNextToken - Provide a simple token buffer.  CurTok is the current
-/// token the parser is looking at.  getNextToken reads another token from the
-/// lexer and updates CurTok with its results.
-static int CurTok;
-static int getNextToken();
+#include "TokenBuffer.h"
 
-///BinaryPrecedence - This holds the precedence for each binary operator that is defined. if not binary operator return -1. the expression “a+b+(c+d)*e*f+g”. Operator precedence parsing considers this as a stream of primary expressions separated by binary operators. As such, it will first parse the leading primary expression “a”, then it will see the pairs [+, b] [+, (c+d)] [*, e] [*, f] and [+, g].
-static std::map<char, int> BinopPrecedence;
+/// Parser - builds the AST from the tokens of one Lexer, pulled one at a time,
+/// or of a TokenBuffer lexed up front. The token buffer and the operator table
+/// are per parser, so several parsers can work on different sources at the
+/// same time.
+class Parser {
+    //exactly one of them is set; TokIdx is the next token to read from Toks
+    Lexer *Lex;
+    const TokenBuffer *Toks;
+    size_t TokIdx;
 
-///numberExpr ::= number;  token is tok_number,it will create NumberExprAST node.
-static std::unique_ptr<ExprAST> ParseNumberExpr();
+    /// CurTok/getNextToken - Provide a simple token buffer.  CurTok is the current
+    /// token the parser is looking at.  getNextToken reads another token from the
+    /// lexer and updates CurTok with its results.
+    int CurTok;
+    //the identifier/number of CurTok
+    SymbolID CurIdentifier;
+    double CurNumVal;
 
-/// expression ::= primary binoprhs
-///  an expression is a primary expression potentially followed by a sequence of [binop,primaryexpr] pairs:
-static std::unique_ptr<ExprAST> ParseExpression();
+    ///BinaryPrecedence - This holds the precedence for each binary operator that is defined. if not binary operator return -1. the expression “a+b+(c+d)*e*f+g”. Operator precedence parsing considers this as a stream of primary expressions separated by binary operators. As such, it will first parse the leading primary expression “a”, then it will see the pairs [+, b] [+, (c+d)] [*, e] [*, f] and [+, g].
+    ///indexed by the operator character, 0 means not a binary operator
+    int BinopPrecedence[256];
 
-//parenexpr := '(' expression ')'
-static std::unique_ptr<ExprAST> ParseParenExpr();
+    //Arena - where the nodes of the item being parsed go
+    ASTArena *Arena;
 
-/// identifierexpr
-/// ::= identifier
-/// ::= identifier '(' expression* ')'
-/// It handles this by checking to see if the token after the identifier is a ‘(‘ token, constructing either a VariableExprAST or CallExprAST node as appropriate.
-static std::unique_ptr<ExprAST> ParseIdentifierExpr();
+    //the explicit stacks of ParseExpression, kept so their memory is reused
+    struct PendingOp {
+        char Op;
+        int Prec;
+    };
+    //ExprFrame - an expression being parsed: the whole expression, one inside
+    //parentheses, a call argument or a part of an if or for. Its pending
+    //operators are the ones above OpBase on OpStack. An if or for frame moves
+    //on to its next part when one is done.
+    struct ExprFrame {
+        enum FrameKind { TopLevel, Paren, Call, IfCond, IfThen, IfElse, ForStart, ForEnd, ForStep, ForBody } Kind;
+        size_t OpBase;
+        //the callee of a call, the loop variable of a for
+        SymbolID Name;
+        //where the finished arguments of the call, or parts of the if/for, start on ValStack
+        size_t OperandBase;
+    };
+    std::vector<ExprAST *> ValStack;
+    std::vector<PendingOp> OpStack;
+    std::vector<ExprFrame> FrameStack;
 
-/// primary
-/// ::= identifierexpr
-/// ::= numberexpr
-/// ::= parenexpr
-static std::unique_ptr<ExprAST> ParsePrimary();
+    /// expression ::= primary (binop primary)*
+    /// primary
+    /// ::= number
+    /// ::= identifier
+    /// ::= identifier '(' expression* ')'
+    /// ::= '(' expression ')'
+    /// ::= 'if' expression 'then' expression 'else' expression
+    /// ::= 'for' identifier '=' expression ',' expression (',' expression)? 'in' expression
+    /// The else branch and the loop body extend as far right as they can. The
+    /// step of a for defaults to 1.
+    /// Parsed without recursion: operands and operators go on explicit stacks
+    /// (shunting-yard), '(' and calls push a frame instead of a native call,
+    /// so nesting depth only costs heap. Operators of equal precedence group to
+    /// the left, the same trees the recursive ParseBinOpRHS used to build.
+    ExprAST *ParseExpression();
 
-static int GetTokPrecedence();
+    /// ReduceOps - pop the operators above OpBase that bind at least as
+    /// tightly as MinPrec, combining operands into BinaryExprAST nodes
+    void ReduceOps(size_t OpBase, int MinPrec);
 
-/// binoprhs ::= ('+' primary)*
-static std::unique_ptr<ExprAST> ParseBinOpRHS(int ExprPrec, std::unique_ptr<ExprAST> LHS);
+    int GetTokPrecedence();
 
-/// prototype ::= id '(' id* ')' ;The next thing missing is handling of function prototypes.
-/// function prototypes : id(id id id)
-static std::unique_ptr<PrototypeAST> ParsePrototype();
+    /// prototype ::= id '(' id* ')' ;The next thing missing is handling of function prototypes.
+    /// function prototypes : id(id id id)
+    std::unique_ptr<PrototypeAST> ParsePrototype();
 
-//definition ::= 'def' prototype expression
-static std::unique_ptr<FunctionAST> ParseDefinition();
+    Parser(Lexer *Lex, const TokenBuffer *Toks);
 
-/// In addition, we support ‘extern’ to declare functions like ‘sin’ and ‘cos’ as well as to support forward declaration of user functions. These ‘extern’s are just prototypes with no body:
-static std::unique_ptr<PrototypeAST> ParseExtern();
+   public:
+    /// The standard binary operators are installed, 1 is lowest precedence.
+    explicit Parser(Lexer &Lex) : Parser(&Lex, nullptr) {}
+    explicit Parser(const TokenBuffer &Toks) : Parser(nullptr, &Toks) {}
 
-/// toplevelexpr ::= expression
-static std::unique_ptr<FunctionAST> ParseTopLevelExpr();
+    int getCurTok() const { return CurTok; }
+    int getNextToken();
+
+    /// skipToNextTopLevel - error recovery after a failed top-level item. With a
+    /// TokenBuffer this jumps straight to the next 'def'/'extern'; reading from
+    /// a Lexer (maybe an interactive one) it only drops the current token.
+    void skipToNextTopLevel();
+
+    /// setBinopPrecedence - declare Op as a binary operator, Prec <= 0 removes it
+    void setBinopPrecedence(char Op, int Prec) { BinopPrecedence[(unsigned char)Op] = Prec > 0 ? Prec : 0; }
+
+    //definition ::= 'def' prototype expression
+    std::unique_ptr<FunctionAST> ParseDefinition();
+
+    /// In addition, we support ‘extern’ to declare functions like ‘sin’ and ‘cos’ as well as to support forward declaration of user functions. These ‘extern’s are just prototypes with no body:
+    std::unique_ptr<PrototypeAST> ParseExtern();
+
+    /// toplevelexpr ::= expression
+    std::unique_ptr<FunctionAST> ParseTopLevelExpr();
+};
 
 #endif
\ No newline at end of file
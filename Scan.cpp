@@ -0,0 +1,186 @@
+#include "Scan.h"
+#include <cctype>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SCAN_X86 1
+#include <immintrin.h>
+//AVX2 code is compiled per function, the rest of the build stays baseline x86-64
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+//===----------------------------------------------------------------------===//
+// Character classes
+//===----------------------------------------------------------------------===//
+// scalar() is the definition, sse2()/avx2() set a lane to 0xff for a member.
+// Bytes >= 0x80 are negative in the signed compares, so they never fall into
+// an ascii range.
+
+struct SpaceClass {
+    static bool scalar(char C) { return isspace((unsigned char)C); }
+#ifdef SCAN_X86
+    static __m128i sse2(__m128i V) {
+        // '\t'..'\r' is 9..13
+        __m128i Ctrl = _mm_and_si128(_mm_cmpgt_epi8(V, _mm_set1_epi8(8)), _mm_cmplt_epi8(V, _mm_set1_epi8(14)));
+        return _mm_or_si128(Ctrl, _mm_cmpeq_epi8(V, _mm_set1_epi8(' ')));
+    }
+    TARGET_AVX2 static __m256i avx2(__m256i V) {
+        __m256i Ctrl = _mm256_and_si256(_mm256_cmpgt_epi8(V, _mm256_set1_epi8(8)),
+                                        _mm256_cmpgt_epi8(_mm256_set1_epi8(14), V));
+        return _mm256_or_si256(Ctrl, _mm256_cmpeq_epi8(V, _mm256_set1_epi8(' ')));
+    }
+#endif
+};
+
+struct CommentClass {
+    static bool scalar(char C) { return '\n' != C && '\r' != C; }
+#ifdef SCAN_X86
+    static __m128i sse2(__m128i V) {
+        __m128i EOL = _mm_or_si128(_mm_cmpeq_epi8(V, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(V, _mm_set1_epi8('\r')));
+        return _mm_xor_si128(EOL, _mm_set1_epi8(-1));
+    }
+    TARGET_AVX2 static __m256i avx2(__m256i V) {
+        __m256i EOL = _mm256_or_si256(_mm256_cmpeq_epi8(V, _mm256_set1_epi8('\n')),
+                                      _mm256_cmpeq_epi8(V, _mm256_set1_epi8('\r')));
+        return _mm256_xor_si256(EOL, _mm256_set1_epi8(-1));
+    }
+#endif
+};
+
+struct DigitClass {
+    static bool scalar(char C) { return C >= '0' && C <= '9'; }
+#ifdef SCAN_X86
+    static __m128i sse2(__m128i V) {
+        return _mm_and_si128(_mm_cmpgt_epi8(V, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(V, _mm_set1_epi8('9' + 1)));
+    }
+    TARGET_AVX2 static __m256i avx2(__m256i V) {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(V, _mm256_set1_epi8('0' - 1)),
+                                _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), V));
+    }
+#endif
+};
+
+struct IdentClass {
+    static bool scalar(char C) { return isalnum((unsigned char)C); }
+#ifdef SCAN_X86
+    static __m128i sse2(__m128i V) {
+        // 'A'..'Z' | 0x20 is 'a'..'z'
+        __m128i Lower = _mm_or_si128(V, _mm_set1_epi8(0x20));
+        __m128i Alpha = _mm_and_si128(_mm_cmpgt_epi8(Lower, _mm_set1_epi8('a' - 1)),
+                                      _mm_cmplt_epi8(Lower, _mm_set1_epi8('z' + 1)));
+        return _mm_or_si128(Alpha, DigitClass::sse2(V));
+    }
+    TARGET_AVX2 static __m256i avx2(__m256i V) {
+        __m256i Lower = _mm256_or_si256(V, _mm256_set1_epi8(0x20));
+        __m256i Alpha = _mm256_and_si256(_mm256_cmpgt_epi8(Lower, _mm256_set1_epi8('a' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), Lower));
+        return _mm256_or_si256(Alpha, DigitClass::avx2(V));
+    }
+#endif
+};
+
+struct NumberClass {
+    static bool scalar(char C) { return DigitClass::scalar(C) || '.' == C; }
+#ifdef SCAN_X86
+    static __m128i sse2(__m128i V) {
+        return _mm_or_si128(DigitClass::sse2(V), _mm_cmpeq_epi8(V, _mm_set1_epi8('.')));
+    }
+    TARGET_AVX2 static __m256i avx2(__m256i V) {
+        return _mm256_or_si256(DigitClass::avx2(V), _mm256_cmpeq_epi8(V, _mm256_set1_epi8('.')));
+    }
+#endif
+};
+
+//===----------------------------------------------------------------------===//
+// Scan loops
+//===----------------------------------------------------------------------===//
+// The vector loops only load whole blocks inside [P, End), the scalar loop
+// finishes the remaining bytes.
+
+template <typename Class>
+const char *scanScalar(const char *P, const char *End) {
+    while (P != End && Class::scalar(*P)) {
+        ++P;
+    }
+    return P;
+}
+
+#ifdef SCAN_X86
+template <typename Class>
+const char *scanSSE2(const char *P, const char *End) {
+    for (; End - P >= 16; P += 16) {
+        __m128i V     = _mm_loadu_si128((const __m128i *)P);
+        unsigned Miss = ~(unsigned)_mm_movemask_epi8(Class::sse2(V)) & 0xffff;
+        if (Miss) {
+            return P + __builtin_ctz(Miss);
+        }
+    }
+    return scanScalar<Class>(P, End);
+}
+
+template <typename Class>
+TARGET_AVX2 const char *scanAVX2(const char *P, const char *End) {
+    for (; End - P >= 32; P += 32) {
+        __m256i V     = _mm256_loadu_si256((const __m256i *)P);
+        unsigned Miss = ~(unsigned)_mm256_movemask_epi8(Class::avx2(V));
+        if (Miss) {
+            return P + __builtin_ctz(Miss);
+        }
+    }
+    return scanSSE2<Class>(P, End);
+}
+#endif
+
+#define SCANNERS_FOR(Loop)                                                         \
+    {                                                                              \
+        Loop<SpaceClass>, Loop<CommentClass>, Loop<IdentClass>, Loop<NumberClass> \
+    }
+
+const Scanners ScalarScanners = SCANNERS_FOR(scanScalar);
+#ifdef SCAN_X86
+const Scanners SSE2Scanners = SCANNERS_FOR(scanSSE2);
+const Scanners AVX2Scanners = SCANNERS_FOR(scanAVX2);
+#endif
+
+}  // end anonymous namespace
+
+ScanISA getHostScanISA() {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return scan_avx2;
+    }
+    //SSE2 is part of x86-64
+    return scan_sse2;
+#else
+    return scan_scalar;
+#endif
+}
+
+const Scanners &getScanners(ScanISA ISA) {
+    ISA = ISA < getHostScanISA() ? ISA : getHostScanISA();
+    switch (ISA) {
+#ifdef SCAN_X86
+        case scan_avx2:
+            return AVX2Scanners;
+        case scan_sse2:
+            return SSE2Scanners;
+#endif
+        default:
+            return ScalarScanners;
+    }
+}
+
+static ScanISA CurISA = getHostScanISA();
+Scanners CurScanners  = getScanners(CurISA);
+
+ScanISA setScanISA(ScanISA ISA) {
+    CurISA      = ISA < getHostScanISA() ? ISA : getHostScanISA();
+    CurScanners = getScanners(CurISA);
+    return CurISA;
+}
+
+ScanISA getScanISA() {
+    return CurISA;
+}
@@ -0,0 +1,41 @@
+#ifndef __SCAN_H__
+#define __SCAN_H__
+//===----------------------------------------------------------------------===//
+// Character class scanners used by the lexer
+//===----------------------------------------------------------------------===//
+// Each scanner returns the first position in [P, End) whose character is not in
+// its class (End if all of them are). On x86-64 they test 16 (SSE2) or 32
+// (AVX2) bytes per step, the scalar loop handles the tail and other targets.
+
+enum ScanISA {
+    scan_scalar = 0,
+    scan_sse2   = 1,
+    scan_avx2   = 2,
+};
+
+typedef const char *(*ScanFn)(const char *P, const char *End);
+
+struct Scanners {
+    ScanFn SkipSpace;    // isspace: ' ' \t \n \v \f \r
+    ScanFn SkipComment;  // everything but '\n' and '\r'
+    ScanFn SkipIdent;    // [a-zA-Z0-9]
+    ScanFn SkipNumber;   // [0-9.]
+};
+
+/// getHostScanISA - the widest path this CPU supports, checked at runtime.
+ScanISA getHostScanISA();
+
+/// setScanISA - switch the scanners the lexer uses, picked on startup with
+/// getHostScanISA(). An ISA the host lacks falls back to the best one it has,
+/// the ISA actually in use is returned.
+ScanISA setScanISA(ScanISA ISA);
+ScanISA getScanISA();
+
+/// getScanners - the scanners of ISA, also the ones not in use (they must all
+/// find the same boundaries)
+const Scanners &getScanners(ScanISA ISA);
+
+//the scanners currently selected
+extern Scanners CurScanners;
+
+#endif
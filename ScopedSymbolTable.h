@@ -0,0 +1,61 @@
+#ifndef __SCOPEDSYMBOLTABLE_H__
+#define __SCOPEDSYMBOLTABLE_H__
+#include <cassert>
+#include "AllInclude.h"
+#include "Symbol.h"
+//===----------------------------------------------------------------------===//
+// Scoped symbol table
+//===----------------------------------------------------------------------===//
+
+/// ScopedSymbolTable - what each name is bound to in the innermost scope that
+/// binds it. SymbolIDs are small and dense, so the current bindings are an
+/// array indexed by SymbolID: lookup is one bounds check and a load, no hashing
+/// or compares. bind() saves the binding it shadows on an undo log and
+/// popScope() puts those back, newest first, so nested scopes (and a name bound
+/// twice in one scope) unwind correctly. ValueT() means unbound.
+template <typename ValueT>
+class ScopedSymbolTable {
+    std::vector<ValueT> Slots;
+    struct Shadowed {
+        SymbolID Name;
+        ValueT Old;
+    };
+    std::vector<Shadowed> UndoLog;
+    //UndoLog size when each open scope was pushed
+    std::vector<size_t> Scopes;
+
+   public:
+    void pushScope() { Scopes.push_back(UndoLog.size()); }
+
+    void popScope() {
+        assert(!Scopes.empty() && "no scope to pop");
+        for (size_t Base = Scopes.back(); UndoLog.size() != Base; UndoLog.pop_back()) {
+            Slots[UndoLog.back().Name] = UndoLog.back().Old;
+        }
+        Scopes.pop_back();
+    }
+
+    /// bind - bind Name to V in the innermost scope
+    void bind(SymbolID Name, ValueT V) {
+        assert(!Scopes.empty() && "binding outside of any scope");
+        if (Name >= Slots.size()) {
+            Slots.resize(std::max<size_t>(Name + 1, Slots.size() * 2), ValueT());
+        }
+        UndoLog.push_back({Name, Slots[Name]});
+        Slots[Name] = V;
+    }
+
+    /// lookup - the innermost binding of Name, ValueT() if there is none
+    ValueT lookup(SymbolID Name) const { return Name < Slots.size() ? Slots[Name] : ValueT(); }
+
+    /// Scope - pushes a scope for as long as it lives
+    class Scope {
+        ScopedSymbolTable &Table;
+
+       public:
+        explicit Scope(ScopedSymbolTable &Table) : Table(Table) { Table.pushScope(); }
+        ~Scope() { Table.popScope(); }
+    };
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "AST.h"
+#include <cmath>
+
+//===----------------------------------------------------------------------===//
+// AST simplification
+//===----------------------------------------------------------------------===//
+// Runs on the tree before codegen, so constant-heavy code never reaches
+// IRBuilder as instructions. Only rewrites that give bit for bit the result
+// the IR would compute (IEEE doubles, no fast-math) are made:
+//  - operators on two constants are folded
+//  - a constant operand of '+' or '*' goes to the right, as InstCombine does
+//  - x*1 and x-0 become x, x+0 becomes x when x can't be -0 (-0 + 0 is +0)
+// x*0 is left alone, it is NaN for an infinite or NaN x.
+//  - an if with a constant condition becomes the branch it takes
+
+namespace {
+
+//how deep cannotBeNegativeZero looks, a long chain of '+' costs no more
+const unsigned MaxSignDepth = 6;
+
+/// cannotBeNegativeZero - true if E is known never to evaluate to -0.0
+bool cannotBeNegativeZero(const ExprAST *E, unsigned Depth = 0) {
+    if (auto *Num = dyn_cast<NumberExprAST>(E)) {
+        return !std::signbit(Num->getVal());
+    }
+    auto *Bin = dyn_cast<BinaryExprAST>(E);
+    if (!Bin || Depth == MaxSignDepth) {
+        return false;
+    }
+    switch (Bin->getOp()) {
+        case '<':
+            //0.0 or 1.0
+            return true;
+        case '+':
+            //a sum is -0 only if both sides are
+            return cannotBeNegativeZero(Bin->getLHS(), Depth + 1) || cannotBeNegativeZero(Bin->getRHS(), Depth + 1);
+        default:
+            return false;
+    }
+}
+
+/// foldBinary - L Op R, false for an operator codegen does not know. Done in
+/// APFloat like IRBuilder's own constant folding, so even a NaN comes out with
+/// the same bits as in the unsimplified IR (the host FPU may pick another one)
+bool foldBinary(char Op, double L, double R, double &Result) {
+    APFloat Val(L);
+    switch (Op) {
+        case '+':
+            Val.add(APFloat(R), APFloat::rmNearestTiesToEven);
+            break;
+        case '-':
+            Val.subtract(APFloat(R), APFloat::rmNearestTiesToEven);
+            break;
+        case '*':
+            Val.multiply(APFloat(R), APFloat::rmNearestTiesToEven);
+            break;
+        case '<': {
+            //fcmp ult: true if less or unordered
+            APFloat::cmpResult Cmp = Val.compare(APFloat(R));
+            Result = APFloat::cmpLessThan == Cmp || APFloat::cmpUnordered == Cmp ? 1.0 : 0.0;
+            return true;
+        }
+        default:
+            return false;
+    }
+    Result = Val.convertToDouble();
+    return true;
+}
+
+}  // end anonymous namespace
+
+ExprAST *NumberExprAST::simplify(ASTArena &Arena) {
+    return this;
+}
+
+ExprAST *VariableExprAST::simplify(ASTArena &Arena) {
+    return this;
+}
+
+ExprAST *BinaryExprAST::simplify(ASTArena &Arena) {
+    ExprAST *&LHS = Ops[0];
+    ExprAST *&RHS = Ops[1];
+    auto *L       = dyn_cast<NumberExprAST>(LHS);
+    auto *R       = dyn_cast<NumberExprAST>(RHS);
+    double Folded;
+    if (L && R && foldBinary(Op, L->getVal(), R->getVal(), Folded)) {
+        return Arena.create<NumberExprAST>(Folded);
+    }
+
+    //a constant has no side effects, moving it does not reorder any calls
+    if (L && !R && ('+' == Op || '*' == Op)) {
+        std::swap(LHS, RHS);
+        std::swap(L, R);
+    }
+    if (!R) {
+        return this;
+    }
+
+    double C = R->getVal();
+    if ('*' == Op && 1.0 == C) {
+        return LHS;
+    }
+    //x - +0 is x for every x, so is x + -0; x + +0 only turns -0 into +0
+    bool PosZero = 0.0 == C && !std::signbit(C);
+    bool NegZero = 0.0 == C && std::signbit(C);
+    if (('-' == Op && PosZero) || ('+' == Op && (NegZero || (PosZero && cannotBeNegativeZero(LHS))))) {
+        return LHS;
+    }
+    return this;
+}
+
+ExprAST *CallExprAST::simplify(ASTArena &Arena) {
+    return this;
+}
+
+ExprAST *IfExprAST::simplify(ASTArena &Arena) {
+    if (auto *C = dyn_cast<NumberExprAST>(getCond())) {
+        //fcmp one: neither 0 nor NaN
+        return C->getVal() < 0.0 || C->getVal() > 0.0 ? getThen() : getElse();
+    }
+    return this;
+}
+
+ExprAST *ForExprAST::simplify(ASTArena &Arena) {
+    return this;
+}
+
+void FunctionAST::simplify() {
+    //post-order: a node is simplified once all of its operands are, and the
+    //node replacing it goes into the slot it came from
+    struct Frame {
+        ExprAST **Slot;
+        unsigned NextOperand;
+    };
+    SmallVector<Frame, 32> Stack;
+    Stack.push_back({&Body, 0});
+    while (!Stack.empty()) {
+        Frame &Top                          = Stack.back();
+        MutableArrayRef<ExprAST *> Operands = (*Top.Slot)->getOperands();
+        if (Top.NextOperand != Operands.size()) {
+            ExprAST **Operand = &Operands[Top.NextOperand++];
+            Stack.push_back({Operand, 0});
+            continue;
+        }
+        *Top.Slot = (*Top.Slot)->simplify(*Arena);
+        Stack.pop_back();
+    }
+}
@@ -0,0 +1,36 @@
+#include "SourceBuffer.h"
+#include "Error.h"
+#include "llvm/Support/Process.h"
+
+std::unique_ptr<SourceBuffer> SourceBuffer::create(StringRef Filename) {
+    // a terminal can't be read to EOF up front, the user is still typing
+    if ("-" == Filename && sys::Process::StandardInIsUserInput()) {
+        return std::unique_ptr<SourceBuffer>(new SourceBuffer(nullptr, true));
+    }
+
+    //mmap the file, or read the whole pipe in large blocks
+    auto BufOrErr = MemoryBuffer::getFileOrSTDIN(Filename);
+    if (!BufOrErr) {
+        std::string Message = "could not open '" + Filename.str() + "': " + BufOrErr.getError().message();
+        LogError(Message.c_str());
+        return nullptr;
+    }
+    return std::unique_ptr<SourceBuffer>(new SourceBuffer(std::move(*BufOrErr), false));
+}
+
+bool SourceBuffer::refill() {
+    if (!Interactive) {
+        return false;
+    }
+
+    Line.clear();
+    char Chunk[4096];
+    while (fgets(Chunk, sizeof(Chunk), stdin)) {
+        Line += Chunk;
+        // a line longer than Chunk comes back in pieces
+        if ('\n' == Line.back()) {
+            break;
+        }
+    }
+    return !Line.empty();
+}
@@ -0,0 +1,41 @@
+#ifndef __SOURCEBUFFER_H__
+#define __SOURCEBUFFER_H__
+#include "AllInclude.h"
+#include "llvm/Support/MemoryBuffer.h"
+//===----------------------------------------------------------------------===//
+// Source buffer
+//===----------------------------------------------------------------------===//
+
+/// SourceBuffer - holds the text the lexer scans as one contiguous block, so the
+/// lexer can walk it with a pointer and hand out StringRef tokens that point
+/// straight into it.
+///  - a file is mmap'ed (MemoryBuffer picks mmap for anything but tiny files)
+///  - piped stdin is read to EOF in large blocks
+///  - an interactive terminal is read one line at a time, so the REPL prompt
+///    still works; refill() moves on to the next line.
+/// The contents are always followed by a '\0' sentinel, *end() == 0.
+class SourceBuffer {
+    std::unique_ptr<MemoryBuffer> Buffer;
+    //current line when reading from a terminal
+    std::string Line;
+    bool Interactive;
+
+    SourceBuffer(std::unique_ptr<MemoryBuffer> Buffer, bool Interactive)
+        : Buffer(std::move(Buffer)), Interactive(Interactive) {}
+
+   public:
+    /// create - open Filename, "-" means stdin. Returns null and reports the
+    /// error if the file can not be read.
+    static std::unique_ptr<SourceBuffer> create(StringRef Filename);
+
+    const char *begin() const { return Interactive ? Line.data() : Buffer->getBufferStart(); }
+    const char *end() const { return Interactive ? Line.data() + Line.size() : Buffer->getBufferEnd(); }
+    bool isInteractive() const { return Interactive; }
+
+    /// refill - read the next line in interactive mode, the old contents (and
+    /// every StringRef into them) are discarded. Returns false at EOF, a
+    /// file/pipe buffer is complete from the start so it never refills.
+    bool refill();
+};
+
+#endif
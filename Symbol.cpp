@@ -0,0 +1,68 @@
+#include "Symbol.h"
+#include <cassert>
+#include <mutex>
+#include "llvm/ADT/StringMap.h"
+
+namespace {
+
+/// SymbolTable - StringMap entries never move, so a name handed out by
+/// getSymbolName stays valid while the table keeps growing.
+class SymbolTable {
+    std::mutex Lock;
+    StringMap<SymbolID> IDs;
+    std::vector<const StringMapEntry<SymbolID> *> Names;
+
+   public:
+    SymbolTable() {
+        //must match the fixed IDs in Symbol.h
+        intern("def");
+        intern("extern");
+        intern("");
+        intern("if");
+        intern("then");
+        intern("else");
+        intern("for");
+        intern("in");
+    }
+
+    SymbolID intern(StringRef Name) {
+        std::lock_guard<std::mutex> Guard(Lock);
+        auto Result = IDs.insert(std::make_pair(Name, (SymbolID)Names.size()));
+        if (Result.second) {
+            Names.push_back(&*Result.first);
+        }
+        return Result.first->second;
+    }
+
+    StringRef getName(SymbolID ID) {
+        std::lock_guard<std::mutex> Guard(Lock);
+        assert(ID < Names.size() && "symbol was never interned");
+        return Names[ID]->getKey();
+    }
+};
+
+SymbolTable &getSymbolTable() {
+    //built on first use, so lexers in static initializers work too
+    static SymbolTable Table;
+    return Table;
+}
+
+}  // end anonymous namespace
+
+SymbolID internSymbol(StringRef Name) {
+    //IDs never change once handed out, so each thread remembers the ones it has
+    //seen and only takes the table lock for new names; parsers running side by
+    //side would otherwise queue on it for every identifier
+    static thread_local StringMap<SymbolID> Seen;
+    auto It = Seen.find(Name);
+    if (It != Seen.end()) {
+        return It->second;
+    }
+    SymbolID ID = getSymbolTable().intern(Name);
+    Seen.insert(std::make_pair(Name, ID));
+    return ID;
+}
+
+StringRef getSymbolName(SymbolID ID) {
+    return getSymbolTable().getName(ID);
+}
@@ -0,0 +1,38 @@
+#ifndef __SYMBOL_H__
+#define __SYMBOL_H__
+//===----------------------------------------------------------------------===//
+// Symbol interning
+//===----------------------------------------------------------------------===//
+#include "AllInclude.h"
+
+/// SymbolID - a compact handle for an interned identifier. The same spelling
+/// always maps to the same ID, in every lexer and on every thread, so later
+/// stages compare and hash integers instead of strings.
+typedef unsigned SymbolID;
+
+// Keywords are interned first, at fixed IDs, so the lexer can tell them apart
+// from identifiers with an integer compare.
+enum : SymbolID {
+    sym_def    = 0,
+    sym_extern = 1,
+    //the empty name of the functions made for top-level expressions
+    sym_anon = 2,
+    sym_if   = 3,
+    sym_then = 4,
+    sym_else = 5,
+    sym_for  = 6,
+    sym_in   = 7,
+
+    //first ID available to ordinary identifiers
+    sym_first_user = 8,
+};
+
+/// internSymbol - the ID of Name, adding it the first time it is seen.
+/// Thread safe.
+SymbolID internSymbol(StringRef Name);
+
+/// getSymbolName - the spelling of an interned symbol. The returned string
+/// stays valid for the life of the process. Thread safe.
+StringRef getSymbolName(SymbolID ID);
+
+#endif
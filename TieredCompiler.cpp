@@ -0,0 +1,121 @@
+#include "TieredCompiler.h"
+#include "AST.h"
+#include "Optimize.h"
+
+TieredCompiler::TieredCompiler(orc::KaleidoscopeJIT &JIT, std::mutex &JITLock, const FunctionProtoMap &Protos,
+                               FastMathFlags FMF, uint64_t Threshold)
+    : JIT(JIT),
+      JITLock(JITLock),
+      Protos(Protos),
+      DL(JIT.getTargetMachine().createDataLayout()),
+      FMF(FMF),
+      Threshold(Threshold),
+      Stopping(false),
+      NumRecompiled(0),
+      Worker(&TieredCompiler::run, this) {}
+
+TieredCompiler::~TieredCompiler() {
+    {
+        std::lock_guard<std::mutex> Guard(QueueLock);
+        Stopping = true;
+    }
+    QueueReady.notify_one();
+    Worker.join();
+}
+
+void TieredCompiler::prepare(CodegenContext &CG) {
+    CG.setCallSlots(&Slots);
+    EntryCounting Counting = {requestTierUp, this, Threshold};
+    CG.setEntryCounting(Counting);
+}
+
+void TieredCompiler::addBaseline(const FunctionAST &FnAST) {
+    SymbolID Name  = FnAST.getProto().getName();
+    CallSlot *Slot = Slots.getOrCreate(Name);
+    {
+        std::lock_guard<std::mutex> Guard(QueueLock);
+        Definitions[Name] = FnAST.flatten();
+    }
+    std::lock_guard<std::mutex> Guard(JITLock);
+    auto Sym = JIT.findSymbol(getSymbolName(Name).str());
+    Slot->Address.store((void *)(intptr_t)cantFail(Sym.getAddress()), std::memory_order_release);
+}
+
+void *TieredCompiler::getAddress(SymbolID Name) {
+    CallSlot *Slot = Slots.lookup(Name);
+    return Slot ? Slot->Address.load(std::memory_order_acquire) : nullptr;
+}
+
+/// requestTierUp - the hook baseline code calls, runs on the thread of the
+/// program. Only queues the slot.
+void TieredCompiler::requestTierUp(void *Self, CallSlot *Slot) {
+    TieredCompiler &TC = *static_cast<TieredCompiler *>(Self);
+    {
+        std::lock_guard<std::mutex> Guard(TC.QueueLock);
+        if (!TC.Requested.insert(Slot).second) {
+            return;
+        }
+        TC.Queue.push_back(Slot);
+    }
+    TC.QueueReady.notify_one();
+}
+
+void TieredCompiler::run() {
+    //the optimizer's cost model comes from a TargetMachine of this thread,
+    //the JIT's is in use by the program's thread
+    std::unique_ptr<TargetMachine> TM;
+    {
+        std::lock_guard<std::mutex> Guard(JITLock);
+        TM = cloneTargetMachine(JIT.getTargetMachine());
+    }
+    while (1) {
+        CallSlot *Slot;
+        FlatFunctionAST *Def;
+        {
+            std::unique_lock<std::mutex> Guard(QueueLock);
+            QueueReady.wait(Guard, [this]() { return Stopping || !Queue.empty(); });
+            if (Stopping) {
+                return;
+            }
+            Slot = Queue.front();
+            Queue.pop_front();
+            //definitions are never redefined or dropped, the copy stays put
+            auto It = Definitions.find(Slot->Name);
+            Def     = It == Definitions.end() ? nullptr : It->second.get();
+        }
+        if (Def) {
+            recompile(*Def, *Slot, TM.get());
+        }
+    }
+}
+
+void TieredCompiler::recompile(FlatFunctionAST &Def, CallSlot &Slot, TargetMachine *TM) {
+    CodegenContext CG("tier-up", &Protos);
+    CG.getModule().setDataLayout(DL);
+    CG.setFastMathFlags(FMF);
+    //the calls go through the slots too, the callees may tier up later
+    CG.setCallSlots(&Slots);
+    Function *F;
+    {
+        //generating the calls reads Protos
+        std::lock_guard<std::mutex> Guard(JITLock);
+        F = Def.codegen(CG);
+    }
+    if (!F) {
+        return;
+    }
+    //the baseline keeps its name in the JIT
+    std::string Name = (F->getName() + ".tier1").str();
+    F->setName(Name);
+    optimizeModule(CG.getModule(), opt_O3, TM);
+
+    std::lock_guard<std::mutex> Guard(JITLock);
+    TargetMachine &JITTM           = JIT.getTargetMachine();
+    CodeGenOpt::Level BaselineLevel = JITTM.getOptLevel();
+    JITTM.setOptLevel(CodeGenOpt::Aggressive);
+    JIT.addModule(CG.takeModule());
+    JITTM.setOptLevel(BaselineLevel);
+    auto Sym = JIT.findSymbol(Name);
+    Slot.Address.store((void *)(intptr_t)cantFail(Sym.getAddress()), std::memory_order_release);
+    ++NumRecompiled;
+}
@@ -0,0 +1,72 @@
+#ifndef __TIEREDCOMPILER_H__
+#define __TIEREDCOMPILER_H__
+//===----------------------------------------------------------------------===//
+// Tiered compilation for the JIT
+//===----------------------------------------------------------------------===//
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include "AllInclude.h"
+#include "CallSlot.h"
+#include "Codegen.h"
+#include "FlatAST.h"
+#include "KaleidoscopeJIT.h"
+#include "llvm/ADT/DenseSet.h"
+
+class FunctionAST;
+
+/// TieredCompiler - two tiers of code for the definitions handed to the JIT.
+/// The baseline is compiled by the caller, cheaply, into code that counts its
+/// entries; calls to a definition load its address from its CallSlot. When a
+/// definition has been entered Threshold times, a background thread compiles it
+/// again at -O3 in an LLVMContext of its own and stores the new address in the
+/// slot, so calls made from then on run the optimized code. Calls compiled
+/// before their callee had a slot (through an extern) stay direct.
+class TieredCompiler {
+    orc::KaleidoscopeJIT &JIT;
+    //held around every use of the JIT and every change of Protos
+    std::mutex &JITLock;
+    const FunctionProtoMap &Protos;
+    const DataLayout DL;
+    const FastMathFlags FMF;
+    CallSlotTable Slots;
+    uint64_t Threshold;
+
+    std::mutex QueueLock;
+    std::condition_variable QueueReady;
+    std::deque<CallSlot *> Queue;
+    //the definitions by name, recompiled from a flat copy. Guarded by QueueLock
+    DenseMap<SymbolID, std::unique_ptr<FlatFunctionAST>> Definitions;
+    //the slots queued once already. Guarded by QueueLock
+    DenseSet<CallSlot *> Requested;
+    bool Stopping;
+    std::atomic<unsigned> NumRecompiled;
+    std::thread Worker;
+
+    static void requestTierUp(void *Self, CallSlot *Slot);
+    void run();
+    void recompile(FlatFunctionAST &Def, CallSlot &Slot, TargetMachine *TM);
+
+   public:
+    //the recompiled code uses the fast-math flags FMF, like the baseline
+    TieredCompiler(orc::KaleidoscopeJIT &JIT, std::mutex &JITLock, const FunctionProtoMap &Protos,
+                   FastMathFlags FMF, uint64_t Threshold);
+    //stops the background thread, recompiles still queued are dropped
+    ~TieredCompiler();
+
+    /// prepare - make CG generate baseline code: calls through the slots,
+    /// entries counted
+    void prepare(CodegenContext &CG);
+
+    /// addBaseline - FnAST was compiled by a prepared context and its module
+    /// handed to the JIT: point its slot at the baseline code and keep a copy
+    /// of the definition for the recompile. Takes JITLock.
+    void addBaseline(const FunctionAST &FnAST);
+
+    /// getAddress - where calls to Name go now, null if it has no baseline yet
+    void *getAddress(SymbolID Name);
+
+    unsigned getNumRecompiled() const { return NumRecompiled; }
+};
+
+#endif
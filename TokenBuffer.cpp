@@ -0,0 +1,34 @@
+#include "TokenBuffer.h"
+
+void TokenBuffer::tokenize(Lexer &Lex, size_t StopOffset) {
+    while (1) {
+        int Tok = Lex.gettok();
+        if ((tok_def == Tok || tok_extern == Tok) && Lex.getTokenOffset() >= StopOffset) {
+            Tok = tok_eof;
+        }
+        uint32_t Payload = 0;
+        if (tok_identifier == Tok) {
+            Payload = Lex.getIdentifier();
+        } else if (tok_number == Tok) {
+            Payload = Numbers.size();
+            Numbers.push_back(Lex.getNumVal());
+        } else if (tok_def == Tok || tok_extern == Tok) {
+            TopLevelStarts.push_back(Kinds.size());
+        }
+
+        Kinds.push_back(Tok);
+        Offsets.push_back(Lex.getTokenOffset());
+        Payloads.push_back(Payload);
+        if (tok_eof == Tok) {
+            return;
+        }
+    }
+}
+
+size_t TokenBuffer::getNextTopLevel(size_t Idx) const {
+    auto It = std::lower_bound(TopLevelStarts.begin(), TopLevelStarts.end(), Idx);
+    if (It == TopLevelStarts.end()) {
+        return size() - 1;
+    }
+    return *It;
+}
@@ -0,0 +1,39 @@
+#ifndef __TOKENBUFFER_H__
+#define __TOKENBUFFER_H__
+//===----------------------------------------------------------------------===//
+// Pre-tokenized input
+//===----------------------------------------------------------------------===//
+#include "AllInclude.h"
+#include "Lexer.h"
+
+/// TokenBuffer - a whole source lexed up front, kept as parallel arrays so the
+/// parser can index any token and lexing can be timed apart from parsing.
+/// Token I is Kinds[I] at byte Offsets[I]; Payloads[I] is the SymbolID of a
+/// tok_identifier or the index into Numbers of a tok_number. The last token is
+/// always tok_eof.
+class TokenBuffer {
+   public:
+    std::vector<int16_t> Kinds;
+    std::vector<uint32_t> Offsets;
+    std::vector<uint32_t> Payloads;
+    std::vector<double> Numbers;
+    //TopLevelStarts - index of every 'def' and 'extern' token in order, an
+    //expression can't contain them, so each one starts a new top-level item
+    std::vector<uint32_t> TopLevelStarts;
+
+    /// tokenize - lex everything Lex has left, up to and including tok_eof.
+    /// With a StopOffset it ends early at the first 'def'/'extern' starting at
+    /// or after that byte, which is replaced by the final tok_eof.
+    void tokenize(Lexer &Lex, size_t StopOffset = SIZE_MAX);
+
+    size_t size() const { return Kinds.size(); }
+    int getKind(size_t Idx) const { return Kinds[Idx]; }
+    SymbolID getIdentifier(size_t Idx) const { return Payloads[Idx]; }
+    double getNumVal(size_t Idx) const { return Numbers[Payloads[Idx]]; }
+
+    /// getNextTopLevel - index of the first 'def'/'extern' at or after token
+    /// Idx, or of tok_eof if there is none
+    size_t getNextTopLevel(size_t Idx) const;
+};
+
+#endif
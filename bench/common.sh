@@ -0,0 +1,70 @@
+# Helpers for the benchmark scripts, which source this file.
+# Build toy with optimization first, e.g. make bench cc="clang++ -O2".
+
+BENCH=$(cd "$(dirname "$0")" && pwd)
+TOY=${TOY:-$BENCH/../toy}
+RUNS=${RUNS:-3}
+CXX=${CXX:-clang++ -O2}
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"; [ -z "$BASE" ] || git -C "$BENCH" worktree prune' EXIT
+export LC_ALL=C
+
+# phases INPUT ARGS... - the wall clock seconds of the phases toy times with
+# -time-phases (code generation, optimization, JIT, execution), best of RUNS
+phases() {
+    input=$1
+    shift
+    best=
+    for run in $(seq $RUNS); do
+        t=$("$TOY" -time-phases "$@" "$input" 2>&1 >/dev/null |
+            sed -n 's/.*Total Execution Time: .*(\(.*\) wall clock).*/\1/p' | head -n 1)
+        best=$(awk -v a="$best" -v b="${t:-0}" 'BEGIN { print (a == "" || b + 0 < a + 0) ? b : a }')
+    done
+    echo "$best"
+}
+
+# phase NAME INPUT ARGS... - the wall clock seconds of one of those phases
+# ("Execution", "Code generation" or "Optimization"), best of RUNS
+phase() {
+    name=$1
+    input=$2
+    shift 2
+    best=
+    for run in $(seq $RUNS); do
+        t=$("$TOY" -time-phases "$@" "$input" 2>&1 >/dev/null |
+            sed -n "s/.* \([0-9.]*\) ( *[0-9.]*%)  $name\$/\1/p" | head -n 1)
+        best=$(awk -v a="$best" -v b="${t:-0}" 'BEGIN { print (a == "" || b + 0 < a + 0) ? b : a }')
+    done
+    echo "$best"
+}
+
+# elapsed CMD... - the wall clock seconds CMD takes, best of RUNS
+elapsed() {
+    best=
+    for run in $(seq $RUNS); do
+        start=$(date +%s.%N)
+        "$@" > /dev/null 2>&1
+        t=$(echo "$start $(date +%s.%N)" | awk '{ printf "%.3f", $2 - $1 }')
+        best=$(awk -v a="$best" -v b="$t" 'BEGIN { print (a == "" || b + 0 < a + 0) ? b : a }')
+    done
+    echo "$best"
+}
+
+# base_tree - the directory of the older tree to compare with, built: BASEDIR
+# if it is set, else revision BASE checked out and built with $CXX (make in a
+# git worktree, which takes a while). Empty if neither is set.
+base_tree() {
+    if [ -n "$BASEDIR" ]; then
+        echo "$BASEDIR"
+    elif [ -n "$BASE" ]; then
+        git -C "$BENCH" worktree add -q --detach "$WORK/base" "$BASE" >&2 &&
+            make -s -C "$WORK/base" cc="$CXX" >&2 && echo "$WORK/base"
+    fi
+}
+
+# build_against DIR SOURCE OUTPUT - compile the benchmark SOURCE against the
+# objects of the tree in DIR, built
+build_against() {
+    objects=$(ls "$1"/*.o | grep -v '/toy\.o$')
+    $CXX $(llvm-config --cxxflags) -I"$1" -o "$3" "$2" $objects $(llvm-config --ldflags --libs) -lpthread -lncurses
+}
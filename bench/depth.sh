@@ -0,0 +1,43 @@
+#!/bin/sh
+# Parsing one deeply nested expression, (((x))) and x+(x+(...)), at depths
+# of 10^4, 10^5 and 10^6, in seconds, best of RUNS. The recursive descent
+# parser from before ran out of stack at 10^5 or 10^6 (with an 8 MB stack),
+# the one with explicit stacks takes time linear in the depth. Set
+# BASE=d43500b^ (or BASEDIR to a built tree of it) for a column with the
+# recursive parser.
+. "$(dirname "$0")/common.sh"
+
+base=$(base_tree)
+if [ -n "$base" ]; then
+    build_against "$base" "$BENCH/parse.cpp" "$WORK/parse-base" || exit 1
+fi
+
+# parse_time PARSER FILE - the best time, or "crash"
+parse_time() {
+    { out=$("$1" "$2" $RUNS); } 2>/dev/null || { echo crash; return; }
+    echo "$out" | sed 's/.* \([0-9.]*\) s$/\1/'
+}
+
+printf "%-12s %8s %12s %12s\n" expression depth this "${BASE:-$BASEDIR}"
+for depth in 10000 100000 1000000; do
+    awk -v n=$depth 'BEGIN {
+        for (i = 0; i < n; i++) printf "("
+        printf "x"
+        for (i = 0; i < n; i++) printf ")"
+        print ""
+    }' > "$WORK/paren.k"
+    awk -v n=$depth 'BEGIN {
+        for (i = 0; i < n; i++) printf "x+("
+        printf "x"
+        for (i = 0; i < n; i++) printf ")"
+        print ""
+    }' > "$WORK/sum.k"
+    for name in paren sum; do
+        case $name in
+        paren) label="(((x)))" ;;
+        sum) label="x+(x+(...))" ;;
+        esac
+        printf "%-12s %8s %12s %12s\n" "$label" $depth "$(parse_time "$BENCH/parse" "$WORK/$name.k")" \
+            "$([ -n "$base" ] && parse_time "$WORK/parse-base" "$WORK/$name.k")"
+    done
+done
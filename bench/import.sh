@@ -0,0 +1,46 @@
+#!/bin/sh
+# Importing earlier definitions for the inliner (-import-definitions, on by
+# default at -O2) against calling them in the JIT's code, seconds, best of
+# RUNS:
+#  - execution of a loop calling small definitions, sq inside norm inside
+#    the loop: inlined, the calls and their overhead are gone
+#  - optimization of 2000 random definitions calling earlier ones: each
+#    module is bigger with the copies, the optimizer takes longer
+. "$(dirname "$0")/common.sh"
+
+cat > "$WORK/calls.k" <<'END'
+def sq(x) x * x;
+def norm(x y) sq(x) + sq(y);
+def dist(n) for i = 0, n in norm(i, i + 1) < 1000000;
+dist(10000000);
+END
+
+awk '
+function expr(n,    k, f, a, s) {
+    if (n <= 1) {
+        return rand() < 0.6 ? "a" : int(rand() * 10) + 0.5
+    }
+    if (d > 0 && rand() < 0.4) {
+        f = int(rand() * d)
+        s = "f" f "(" expr(n - 1)
+        for (a = 1; a < arity[f]; a++) {
+            s = s ", " expr(1)
+        }
+        return s ")"
+    }
+    k = int(rand() * (n - 1)) + 1
+    return "(" expr(k) (rand() < 0.5 ? " + " : " * ") expr(n - k) ")"
+}
+BEGIN {
+    srand(1)
+    for (d = 0; d < 2000; d++) {
+        arity[d] = 1 + int(rand() * 3)
+        printf "def f%d(a%s) %s;\n", d, arity[d] == 1 ? "" : arity[d] == 2 ? " b" : " b c", expr(8)
+    }
+}' > "$WORK/defs.k"
+
+printf "%-32s %10s %26s\n" "" -O2 "-O2 -import-definitions=false"
+printf "%-32s %10s %26s\n" "calls, execution" "$(phase Execution "$WORK/calls.k" -jit -O2)" \
+    "$(phase Execution "$WORK/calls.k" -jit -O2 -import-definitions=false)"
+printf "%-32s %10s %26s\n" "2000 definitions, optimization" "$(phase Optimization "$WORK/defs.k" -jit -O2)" \
+    "$(phase Optimization "$WORK/defs.k" -jit -O2 -import-definitions=false)"
@@ -0,0 +1,51 @@
+#!/bin/sh
+# Top-level expressions with -jit: walking the tree (-interpret, the default)
+# against compiling every one (-interpret=false), in seconds spent in toy's
+# phases, best of RUNS.
+#  - expressions of n nodes: compiling costs about 0.6 ms plus 7.5 us per node,
+#    the walk about 5 ns per node, it always wins
+#  - loops of n iterations over a 5 node body: the walk wins up to a trip count
+#    of some 50000-100000 (the first compile in a process also sets up the
+#    JIT), the cost model has -interpret compile the loop from 58000 on
+. "$(dirname "$0")/common.sh"
+
+echo "expressions of n nodes, some of them calls of a compiled definition"
+printf "%8s %8s %12s %18s\n" n exprs -interpret -interpret=false
+for n in 1 10 100 1000 10000; do
+    exprs=$((20000 / n))
+    [ $exprs -gt 2000 ] && exprs=2000
+    [ $exprs -lt 5 ] && exprs=5
+    awk -v n=$n -v exprs=$exprs '
+    function expr(n,    k) {
+        if (n <= 1) {
+            return rand() < 0.5 ? "x" : int(rand() * 9 + 1)
+        }
+        if (n <= 4 && rand() < 0.5) {
+            return "f(" expr(n - 1) ")"
+        }
+        k = int(rand() * (n - 1)) + 1
+        return "(" expr(k) (rand() < 0.5 ? " + " : " * ") expr(n - k) ")"
+    }
+    BEGIN {
+        srand(1)
+        print "def f(x) x * 0.5 + 1;"
+        for (i = 0; i < exprs; i++) {
+            e = expr(n)
+            gsub("x", "2", e)
+            print e ";"
+        }
+    }' > "$WORK/expr$n.k"
+    printf "%8s %8s %12s %18s\n" $n $exprs "$(phases "$WORK/expr$n.k" -jit)" \
+        "$(phases "$WORK/expr$n.k" -jit -interpret=false)"
+done
+
+echo
+echo "for i = 0, n in i * i + 1"
+printf "%8s %12s %18s  %s\n" n -interpret -interpret=false "-interpret chose"
+for n in 1000 10000 30000 50000 100000 300000 1000000; do
+    echo "for i = 0, $n in i * i + 1;" > "$WORK/loop$n.k"
+    chose=walk
+    "$TOY" -jit "$WORK/loop$n.k" 2>&1 | grep -q "Read top-level expression" && chose=compile
+    printf "%8s %12s %18s  %s\n" $n "$(phases "$WORK/loop$n.k" -jit)" \
+        "$(phases "$WORK/loop$n.k" -jit -interpret=false)" $chose
+done
@@ -0,0 +1,106 @@
+//===----------------------------------------------------------------------===//
+// Number literal parsing: parseNumber against strtod
+//===----------------------------------------------------------------------===//
+// The lexer used to copy each literal into a std::string and call strtod on
+// it. This times both on the same random literals (up to 7 decimals, the
+// kind found in Kaleidoscope code), and checks on those and on random long
+// ones that parseNumber gives the same bits as strtod.
+//
+// usage: numbers [literals] [runs]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "../NumberParser.h"
+
+static double nanosecondsSince(std::chrono::steady_clock::time_point Start, size_t Count) {
+    std::chrono::duration<double, std::nano> Elapsed = std::chrono::steady_clock::now() - Start;
+    return Elapsed.count() / Count;
+}
+
+static bool sameAsStrtod(const std::string &Literal) {
+    double Parsed;
+    if (!parseNumber(Literal.data(), Literal.data() + Literal.size(), Parsed)) {
+        fprintf(stderr, "parseNumber rejects %s\n", Literal.c_str());
+        return false;
+    }
+    double Expected = strtod(Literal.c_str(), nullptr);
+    if (memcmp(&Parsed, &Expected, sizeof(double))) {
+        fprintf(stderr, "%s: parseNumber gives %.17g, strtod %.17g\n", Literal.c_str(), Parsed, Expected);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t Count  = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    unsigned Runs = argc > 2 ? strtoul(argv[2], nullptr, 10) : 5;
+    std::mt19937_64 Random(42);
+
+    std::vector<std::string> Literals;
+    Literals.reserve(Count);
+    for (size_t I = 0; I != Count; ++I) {
+        char Buffer[32];
+        snprintf(Buffer, sizeof(Buffer), "%.*f", int(Random() % 8), (Random() % 1000000) / 997.0);
+        Literals.push_back(Buffer);
+    }
+    //long literals as well, with up to 25 digits and up to 330 zeros, they
+    //take the slow paths
+    std::vector<std::string> Checked(Literals);
+    for (size_t I = 0; I != Count; ++I) {
+        std::string Literal;
+        unsigned NumDigits = 1 + Random() % 25;
+        unsigned Dot       = Random() % (NumDigits + 2);
+        for (unsigned K = 0; K != NumDigits; ++K) {
+            if (K == Dot) {
+                Literal += '.';
+            }
+            Literal += char('0' + Random() % 10);
+        }
+        if (Random() % 4 == 0) {
+            std::string Zeros(Random() % 330, '0');
+            Literal = Literal.find('.') == std::string::npos && Random() % 2 ? "0." + Zeros + Literal : Literal + Zeros;
+        }
+        Checked.push_back(Literal);
+    }
+    for (const std::string &Literal : Checked) {
+        if (!sameAsStrtod(Literal)) {
+            return 1;
+        }
+    }
+    printf("parseNumber and strtod agree on all %zu literals\n", Checked.size());
+
+    double BestParse = 0, BestStrtod = 0, Sum = 0;
+    for (unsigned Run = 0; Run != Runs; ++Run) {
+        auto Start = std::chrono::steady_clock::now();
+        for (const std::string &Literal : Literals) {
+            double Value;
+            parseNumber(Literal.data(), Literal.data() + Literal.size(), Value);
+            Sum += Value;
+        }
+        double Parse = nanosecondsSince(Start, Count);
+
+        //what the lexer did before: the literal was not null-terminated in the source
+        Start = std::chrono::steady_clock::now();
+        for (const std::string &Literal : Literals) {
+            std::string Copy(Literal.data(), Literal.size());
+            Sum += strtod(Copy.c_str(), nullptr);
+        }
+        double Strtod = nanosecondsSince(Start, Count);
+
+        if (!Run || Parse < BestParse) {
+            BestParse = Parse;
+        }
+        if (!Run || Strtod < BestStrtod) {
+            BestStrtod = Strtod;
+        }
+    }
+    //the sum keeps the loops from being optimized away
+    printf("%zu literals, ns per literal, best of %u (%g)\n", Count, Runs, Sum);
+    printf("%12s %16s\n", "parseNumber", "string+strtod");
+    printf("%12.1f %16.1f\n", BestParse, BestStrtod);
+    return 0;
+}
@@ -0,0 +1,63 @@
+//===----------------------------------------------------------------------===//
+// Parsing: every top-level item of a file, parsed and thrown away
+//===----------------------------------------------------------------------===//
+// The file is lexed up front, so only the parser and the allocation and
+// freeing of the trees are timed. Built against the Parser of this tree, or of
+// an older one, see parse.sh and depth.sh.
+//
+// usage: parse file [runs]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "Parser.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s file [runs]\n", argv[0]);
+        return 1;
+    }
+    unsigned Runs = argc > 2 ? strtoul(argv[2], nullptr, 10) : 5;
+    std::unique_ptr<SourceBuffer> Source = SourceBuffer::create(argv[1]);
+    if (!Source) {
+        return 1;
+    }
+    Lexer Lex(*Source);
+    TokenBuffer Toks;
+    Toks.tokenize(Lex);
+
+    double Best     = 0;
+    size_t NumItems = 0;
+    for (unsigned Run = 0; Run != Runs; ++Run) {
+        auto Start = std::chrono::steady_clock::now();
+        Parser P(Toks);
+        P.getNextToken();
+        NumItems = 0;
+        while (tok_eof != P.getCurTok()) {
+            bool Parsed;
+            switch (P.getCurTok()) {
+            case ';':
+                P.getNextToken();
+                continue;
+            case tok_def:
+                Parsed = P.ParseDefinition() != nullptr;
+                break;
+            case tok_extern:
+                Parsed = P.ParseExtern() != nullptr;
+                break;
+            default:
+                Parsed = P.ParseTopLevelExpr() != nullptr;
+                break;
+            }
+            if (!Parsed) {
+                return 1;
+            }
+            ++NumItems;
+        }
+        std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - Start;
+        if (!Run || Elapsed.count() < Best) {
+            Best = Elapsed.count();
+        }
+    }
+    printf("%zu items, best of %u %.3f s\n", NumItems, Runs, Best);
+    return 0;
+}
@@ -0,0 +1,10 @@
+#!/bin/sh
+# Run the benchmarks: all of them, or the ones named (run.sh interpret ...).
+# make bench builds what they need and runs them all.
+cd "$(dirname "$0")" || exit 1
+names=${*:-$(ls *.sh | grep -v -e '^common\.sh$' -e '^run\.sh$' | sed 's/\.sh$//')}
+for name in $names; do
+    echo "== $name"
+    ./$name.sh || exit 1
+    echo
+done
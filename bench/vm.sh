@@ -0,0 +1,40 @@
+#!/bin/sh
+# The bytecode VM (-vm) against the JIT at -O0 and -O2, in seconds for the
+# whole run of toy, best of RUNS:
+#  - a hot call tree, a naive fib: the JIT's code runs several times faster
+#  - 6000 small definitions and one expression: the VM is done in a fraction
+#    of a second, the JIT compiles a module per definition for many seconds
+#  - a small script: no difference worth a JIT
+. "$(dirname "$0")/common.sh"
+
+cat > "$WORK/fib.k" <<'END'
+def fib(n) if n < 2 then n else fib(n - 1) + fib(n - 2)
+fib(35)
+END
+
+awk 'BEGIN {
+    print "def f0(x) x * 2 + 1"
+    for (d = 1; d < 6000; d++) {
+        printf "def f%d(x) if x < %d then f%d(x + 1) * 0.5 else x - %d\n", d, d % 7, d - 1, d % 5
+    }
+    print "f5999(1)"
+}' > "$WORK/defs.k"
+
+cat > "$WORK/small.k" <<'END'
+def sq(x) x * x
+def norm(x y) sq(x) + sq(y)
+def sum(n) for i = 0, n in norm(i, 1)
+sum(100)
+norm(3, 4)
+END
+
+printf "%-16s %8s %8s %8s\n" program -vm "-jit -O0" "-jit -O2"
+for name in fib defs small; do
+    case $name in
+    fib) label="hot call tree" ;;
+    defs) label="6000 defs" ;;
+    small) label="small script" ;;
+    esac
+    printf "%-16s %8s %8s %8s\n" "$label" "$(elapsed "$TOY" -vm "$WORK/$name.k")" \
+        "$(elapsed "$TOY" -jit -O0 "$WORK/$name.k")" "$(elapsed "$TOY" -jit -O2 "$WORK/$name.k")"
+done
@@ -0,0 +1,52 @@
+#!/bin/sh
+# The parser, simplify and the bytecode compiler work with explicit stacks, so
+# -vm must evaluate expressions nested as deep as the input likes. This runs
+# x+(x+(...)), (((x))) and an if in every else branch nested 10^6 deep, with
+# and without -simplify, and checks the results.
+#
+# usage: test/depth.sh [path to toy], run by make check
+
+TOY=${1:-./toy}
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+export LC_ALL=C
+depth=1000000
+
+awk -v n=$depth 'BEGIN {
+    printf "def f(x) "
+    for (i = 0; i < n; i++) printf "x+("
+    printf "x"
+    for (i = 0; i < n; i++) printf ")"
+    print ";"
+    print "f(1);"
+}' > "$DIR/sum.k"
+awk -v n=$depth 'BEGIN {
+    printf "def f(x) "
+    for (i = 0; i < n; i++) printf "("
+    printf "x"
+    for (i = 0; i < n; i++) printf ")"
+    print ";"
+    print "f(2);"
+}' > "$DIR/paren.k"
+awk -v n=$depth 'BEGIN {
+    printf "def f(x) "
+    for (i = 0; i < n; i++) printf "if x < %d then %d else (", i, i
+    printf "x"
+    for (i = 0; i < n; i++) printf ")"
+    print ";"
+    print "f(7.5);"
+}' > "$DIR/if.k"
+
+status=0
+for case in "sum 1000001.000000" "paren 2.000000" "if 8.000000"; do
+    set -- $case
+    for simplify in true false; do
+        result=$("$TOY" -vm -simplify=$simplify "$DIR/$1.k" 2>&1 | sed -n 's/.*Evaluated to //p')
+        if [ "$result" != "$2" ]; then
+            echo "FAIL: -vm -simplify=$simplify on $1 nested $depth deep gives '$result', not $2"
+            status=1
+        fi
+    done
+done
+[ $status -eq 0 ] && echo "depth: -vm evaluates all expressions nested $depth deep"
+exit $status
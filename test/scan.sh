@@ -0,0 +1,75 @@
+#!/bin/sh
+# The scalar, SSE2 and AVX2 scanners of the lexer must find the same token
+# boundaries. This lexes generated inputs with each -scan and diffs the token
+# dumps (and the lexer's errors) against the scalar one.
+#
+# Every character class the scanners skip (whitespace, comment bodies,
+# identifier and number tails) gets runs of each length from 1 to 70, so runs
+# end before, on and after the 16 and 32 byte blocks and their multiples:
+#  - all of them in one input, each followed by more text
+#  - each as the last bytes of an input of its own, where the vector loops
+#    hand the tail to the scalar one
+# On a CPU without AVX2, -scan=avx2 falls back to SSE2.
+#
+# usage: test/scan.sh [path to toy], run by make check
+
+TOY=${1:-./toy}
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+export LC_ALL=C
+
+# run CLASS LENGTH - a run of LENGTH characters of CLASS
+gen='
+function run(class, len,    s, i, c) {
+    s = ""
+    for (i = 0; i < len; i++) {
+        if (class == "ident") {
+            c = substr("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789", i % 62 + 1, 1)
+        } else if (class == "number") {
+            c = i == int(len / 2) && len > 1 ? "." : substr("1234567890", i % 10 + 1, 1)
+        } else if (class == "space") {
+            c = substr(" \t \v  \f\r", i % 8 + 1, 1)
+        } else {
+            # a comment body: anything but a line break, bytes >= 0x80 too
+            c = i % 7 == 3 ? sprintf("%c", 128 + i) : substr("#def(x)1.2 extern;<", i % 19 + 1, 1)
+        }
+        s = s c
+    }
+    return s
+}
+'
+
+awk "$gen"'
+BEGIN {
+    for (len = 1; len <= 70; len++) {
+        printf "def f%s(x) x+%s;", run("ident", len), run("number", len)
+        printf "%sextern g(a)#%s\n", run("space", len), run("comment", len)
+        printf "1.2.%s %s.1.\n", run("number", len), run("ident", len)
+    }
+}' > "$DIR/all.k"
+
+for class in ident number space comment; do
+    len=1
+    while [ $len -le 70 ]; do
+        prefix="def h(y) y+"
+        [ $class = comment ] && prefix="def h(y) y;#"
+        awk -v class=$class -v len=$len -v prefix="$prefix" "$gen"'
+            BEGIN { printf "%s%s", prefix, run(class, len) }' > "$DIR/$class$len.k"
+        len=$((len + 1))
+    done
+done
+
+status=0
+for input in "$DIR"/*.k; do
+    "$TOY" -dump-tokens -scan=scalar "$input" > "$DIR/scalar.out" 2>&1
+    for isa in sse2 avx2; do
+        "$TOY" -dump-tokens -scan=$isa "$input" > "$DIR/$isa.out" 2>&1
+        if ! cmp -s "$DIR/scalar.out" "$DIR/$isa.out"; then
+            echo "FAIL: -scan=$isa differs from -scan=scalar on $(basename "$input"):"
+            diff "$DIR/scalar.out" "$DIR/$isa.out" | head -5
+            status=1
+        fi
+    done
+done
+[ $status -eq 0 ] && echo "scan: the token streams of all $(ls "$DIR"/*.k | wc -l) inputs match"
+exit $status
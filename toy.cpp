@@ -1,100 +1,857 @@
 #include "AST.h"
+#include "BatchEvaluator.h"
+#include "Bytecode.h"
 #include "Codegen.h"
+#include "DefinitionCache.h"
+#include "DefinitionLibrary.h"
 #include "Error.h"
+#include "Interpreter.h"
+#include "KaleidoscopeJIT.h"
 #include "Lexer.h"
+#include "Memoize.h"
+#include "Optimize.h"
+#include "ParallelCodegen.h"
+#include "ParallelParser.h"
 #include "Parser.h"
+#include "Scan.h"
+#include "SourceBuffer.h"
+#include "TieredCompiler.h"
+#include "TokenBuffer.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Timer.h"
 //===----------------------------------------------------------------------===//
 // Top-Level parsing
 //===----------------------------------------------------------------------===//
 
-static void
-HandleDefinition() {
-    if (auto FnAST = ParseDefinition()) {
-        if (auto *FnIR = FnAST->codegen()) {
-            fprintf(stderr, "Read function definition: ");
-            FnIR->print(errs());
-            fprintf(stderr, "\n");
+//generate code from the flat, index based copy of each body instead of the node tree
+static cl::opt<bool> UseFlatAST("flat-ast", cl::desc("Generate code from the flat AST"));
+
+//fold constants and identities in the AST first, -simplify=false to see the unsimplified IR
+static cl::opt<bool> SimplifyAST("simplify", cl::desc("Simplify expressions before generating code"),
+                                 cl::init(true));
+
+static Function *codegenFunction(CodegenContext &CG, FunctionAST &FnAST) {
+    if (SimplifyAST) {
+        FnAST.simplify();
+    }
+    if (UseFlatAST) {
+        return FnAST.flatten()->codegen(CG);
+    }
+    return FnAST.codegen(CG);
+}
+
+//with -jit every definition goes to the JIT in a module of its own and top-level expressions are run
+static std::unique_ptr<orc::KaleidoscopeJIT> TheJIT;
+//the prototypes of all functions the JIT has or may be asked to resolve
+static FunctionProtoMap FunctionProtos;
+//held around every use of the JIT and every change of FunctionProtos, the tiered compiler uses them from its thread
+static std::mutex JITLock;
+//the functions defined in a module other than the current one
+static DenseSet<SymbolID> DefinedFunctions;
+
+static cl::opt<OptLevel> OptimizeLevel(cl::desc("Optimization level:"),
+                                       cl::values(clEnumValN(opt_O0, "O0", "No optimization (default)"),
+                                                  clEnumValN(opt_O1, "O1", "Light optimization (LLVM's O1)"),
+                                                  clEnumValN(opt_O2, "O2", "Default optimization (LLVM's O2)"),
+                                                  clEnumValN(opt_O3, "O3", "Aggressive optimization (LLVM's O3)")),
+                                       cl::init(opt_O0));
+
+//fast-math flags on the arithmetic, and the JIT's instruction selection to match
+static cl::opt<FPMode> FloatingPointMode("fp-mode", cl::desc("Floating point semantics:"),
+                                         cl::values(clEnumValN(fp_strict, "strict", "IEEE arithmetic (default)"),
+                                                    clEnumValN(fp_contract, "contract",
+                                                               "Fuse a * b + c into multiply-adds"),
+                                                    clEnumValN(fp_fast, "fast",
+                                                               "Also reassociate, assume no NaNs or infinities")),
+                                         cl::init(fp_strict));
+
+//-time-phases prints these when the program exits, the compile time of a level against the run time it buys
+static cl::opt<bool> TimePhases("time-phases", cl::desc("Time code generation, optimization, the JIT and execution"));
+static TimerGroup PhaseTimers("toy", "Kaleidoscope phases");
+static Timer CodegenTimer("codegen", "Code generation", PhaseTimers);
+static Timer OptimizeTimer("optimize", "Optimization", PhaseTimers);
+static Timer JITTimer("jit", "Machine code (JIT)", PhaseTimers);
+static Timer RunTimer("run", "Execution", PhaseTimers);
+
+static Timer *phaseTimer(Timer &T) {
+    return TimePhases ? &T : nullptr;
+}
+
+static void optimize(Module &M) {
+    TimeRegion Region(phaseTimer(OptimizeTimer));
+    optimizeModule(M, OptimizeLevel, TheJIT ? &TheJIT->getTargetMachine() : nullptr);
+}
+
+//at -O2 and -O3 each module gets copies of the definitions it calls from earlier ones, for the inliner
+static cl::opt<bool> ImportDefinitions("import-definitions",
+                                       cl::desc("Let the inliner see the definitions handed to the JIT before "
+                                                "(with -jit at -O2 and -O3, not with -tiered or -codegen-threads)"),
+                                       cl::init(true));
+static cl::opt<unsigned> ImportLimit("import-limit",
+                                     cl::desc("The most instructions a definition may have to be imported"),
+                                     cl::init(100));
+//holds IR of the main CodegenContext, gone before it is
+static std::unique_ptr<DefinitionLibrary> Library;
+
+/// stopImporting - report the imports and drop the library
+static void stopImporting() {
+    if (Library && TimePhases) {
+        fprintf(stderr, "Imported %u definitions for inlining\n", Library->getNumImported());
+    }
+    Library.reset();
+}
+
+/// addToJIT - optimize M and hand it to the JIT. The definitions of a module
+/// that holds definitions are kept for the modules after it to import.
+static orc::VModuleKey addToJIT(std::unique_ptr<Module> M, bool HasDefinitions) {
+    std::lock_guard<std::mutex> Guard(JITLock);
+    {
+        TimeRegion Region(phaseTimer(OptimizeTimer));
+        if (Library) {
+            Library->importCallees(M);
+        }
+    }
+    optimize(*M);
+    if (Library && HasDefinitions) {
+        TimeRegion Region(phaseTimer(OptimizeTimer));
+        Library->addModule(*M);
+    }
+    TimeRegion Region(phaseTimer(JITTimer));
+    return TheJIT->addModule(std::move(M));
+}
+
+static cl::opt<bool> Tiered("tiered", cl::desc("Compile definitions fast first and again at -O3 once they are hot "
+                                               "(with -jit, not with -codegen-threads)"));
+static cl::opt<unsigned> TierUpThreshold("tier-up-threshold",
+                                         cl::desc("Entries after which -tiered recompiles a definition"),
+                                         cl::init(1000));
+//with -tiered, the baseline code comes from the loops and the -O3 code from here
+static std::unique_ptr<TieredCompiler> Tiers;
+
+/// stopTiering - stop recompiling, before the globals it uses go away
+static void stopTiering() {
+    if (Tiers && TimePhases) {
+        fprintf(stderr, "Recompiled %u hot definitions at -O3\n", Tiers->getNumRecompiled());
+    }
+    Tiers.reset();
+}
+
+//results of the pure definitions are cached, the wrappers call into these tables
+static cl::opt<bool> Memoize("memoize", cl::desc("Cache the results of definitions that only call pure functions "
+                                                 "(with -jit, not with -tiered)"));
+static cl::opt<unsigned> MemoEntries("memo-entries", cl::desc("The entries in the result cache of each function"),
+                                     cl::init(4096));
+static std::unique_ptr<Memoizer> Memo;
+
+/// stopMemoizing - report how the caches did
+static void stopMemoizing() {
+    if (Memo) {
+        Memo->printStats();
+    }
+}
+
+static void addFunctionProto(PrototypeAST &Proto) {
+    //like FunctionTable, the first prototype of a name is the one calls use
+    std::lock_guard<std::mutex> Guard(JITLock);
+    FunctionProtos.insert(std::make_pair(Proto.getName(), llvm::make_unique<PrototypeAST>(Proto)));
+}
+
+//with -vm nothing goes through LLVM, definitions become bytecode and the VM runs the top-level expressions
+static cl::opt<bool> UseVM("vm", cl::desc("Compile to bytecode and evaluate the top-level expressions in a VM"));
+static std::unique_ptr<BytecodeVM> TheVM;
+
+static void defineInVM(FunctionAST &FnAST) {
+    if (SimplifyAST) {
+        FnAST.simplify();
+    }
+    bool Compiled;
+    {
+        TimeRegion Region(phaseTimer(CodegenTimer));
+        Compiled = TheVM->addDefinition(FnAST);
+    }
+    if (Compiled) {
+        fprintf(stderr, "Read function definition: %s\n", getSymbolName(FnAST.getProto().getName()).str().c_str());
+    }
+}
+
+static void evaluateInVM(FunctionAST &FnAST) {
+    if (SimplifyAST) {
+        FnAST.simplify();
+    }
+    double Result;
+    bool Evaluated;
+    {
+        //compiling an expression to bytecode is one walk, it counts as running it
+        TimeRegion Region(phaseTimer(RunTimer));
+        Evaluated = TheVM->evaluate(FnAST, Result);
+    }
+    if (Evaluated) {
+        fprintf(stderr, "Evaluated to %f\n", Result);
+    }
+}
+
+//-batch evaluates one definition over a table of arguments once the script has run
+static cl::opt<std::string> BatchFunction("batch",
+                                          cl::desc("Evaluate function <name> over the rows of -batch-input after "
+                                                   "the script, printing one result per row (with -jit)"),
+                                          cl::value_desc("name"));
+static cl::opt<std::string> BatchInput("batch-input", cl::desc("The rows for -batch, one number per argument each"),
+                                       cl::value_desc("file"));
+static std::unique_ptr<BatchEvaluator> Batch;
+
+static Function *EmitDefinition(CodegenContext &CG, FunctionAST &FnAST) {
+    if (TheVM) {
+        defineInVM(FnAST);
+        return nullptr;
+    }
+    SymbolID Name = FnAST.getProto().getName();
+    if (DefinedFunctions.count(Name)) {
+        return (Function *)LogErrorV("Function cannot be redefined.");
+    }
+    if (Memo) {
+        CG.setMemoTable(Memo->addDefinition(FnAST));
+    }
+    Function *FnIR;
+    {
+        TimeRegion Region(phaseTimer(CodegenTimer));
+        FnIR = codegenFunction(CG, FnAST);
+    }
+    if (!FnIR && Memo) {
+        //a definition of the same name may follow, and it need not be pure
+        Memo->removeDefinition(Name);
+    }
+    if (FnIR) {
+        fprintf(stderr, "Read function definition: ");
+        FnIR->print(errs());
+        fprintf(stderr, "\n");
+        if (TheJIT) {
+            addFunctionProto(FnAST.getProto());
+            DefinedFunctions.insert(Name);
+            addToJIT(CG.takeModule(), true);
+            if (Tiers) {
+                Tiers->addBaseline(FnAST);
+            }
+            if (Batch) {
+                Batch->addDefinition(FnAST);
+            }
+        }
+    }
+    return FnIR;
+}
+
+static Function *EmitExtern(CodegenContext &CG, PrototypeAST &ProtoAST) {
+    if (TheVM) {
+        TheVM->addExtern(ProtoAST);
+        fprintf(stderr, "Read extern: %s\n", getSymbolName(ProtoAST.getName()).str().c_str());
+        return nullptr;
+    }
+    auto *FnIR = ProtoAST.codegen(CG);
+    if (FnIR) {
+        fprintf(stderr, "Read extern: ");
+        FnIR->print(errs());
+        fprintf(stderr, "\n");
+        if (TheJIT) {
+            addFunctionProto(ProtoAST);
+        }
+    }
+    return FnIR;
+}
+
+/// runTopLevelExpression - JIT FnIR, the function of a top-level expression, call it and print the result
+static void runTopLevelExpression(CodegenContext &CG, Function *FnIR) {
+    //the functions of top-level expressions have no name, the JIT needs one to find it
+    FnIR->setName("__anon_expr");
+    auto H = addToJIT(CG.takeModule(), false);
+    double (*FP)();
+    {
+        std::lock_guard<std::mutex> Guard(JITLock);
+        auto ExprSymbol = TheJIT->findSymbol("__anon_expr");
+        assert(ExprSymbol && "Function not found");
+        FP = (double (*)())(intptr_t)cantFail(ExprSymbol.getAddress());
+    }
+    double Result;
+    {
+        //not under the lock, hot functions get recompiled while it runs
+        TimeRegion Region(phaseTimer(RunTimer));
+        Result = FP();
+    }
+    fprintf(stderr, "Evaluated to %f\n", Result);
+    std::lock_guard<std::mutex> Guard(JITLock);
+    TheJIT->removeModule(H);
+}
+
+//compiling a top-level expression costs far more than walking its tree once, unless it loops a lot
+static cl::opt<bool> InterpretExprs("interpret",
+                                    cl::desc("Evaluate top-level expressions without compiling them where that is "
+                                             "quicker (with -jit and -fp-mode=strict)"),
+                                    cl::init(true));
+
+//the addresses the interpreter has called, definitions never change address
+//(except tiered ones, their slot is asked each time, and the code it pointed
+//to stays). Guarded by JITLock
+static DenseMap<SymbolID, void *> CalleeAddresses;
+
+static void *resolveCallee(SymbolID Name, size_t NumArgs) {
+    std::lock_guard<std::mutex> Guard(JITLock);
+    auto Proto = FunctionProtos.find(Name);
+    if (Proto == FunctionProtos.end() || Proto->second->getNumArgs() != NumArgs) {
+        return nullptr;
+    }
+    if (Tiers) {
+        if (void *Addr = Tiers->getAddress(Name)) {
+            return Addr;
+        }
+    }
+    void *&Addr = CalleeAddresses[Name];
+    if (!Addr) {
+        if (auto Sym = TheJIT->findSymbol(getSymbolName(Name).str())) {
+            Addr = (void *)(intptr_t)cantFail(Sym.getAddress());
+        }
+    }
+    return Addr;
+}
+
+/// EmitTopLevelExpression - with the JIT, evaluate FnAST; without it or if it
+/// cannot be interpreted, generate its function. Null when it was interpreted.
+static Function *EmitTopLevelExpression(CodegenContext &CG, FunctionAST &FnAST) {
+    if (TheVM) {
+        evaluateInVM(FnAST);
+        return nullptr;
+    }
+    //the walk computes strict IEEE results, contracted or fast code may round differently
+    if (TheJIT && InterpretExprs && fp_strict == FloatingPointMode) {
+        double Result;
+        bool Interpreted;
+        {
+            TimeRegion Region(phaseTimer(RunTimer));
+            //folded first, a loop's trip count is then more often a constant the cost model can use
+            if (SimplifyAST) {
+                FnAST.simplify();
+            }
+            Interpreted = interpretTopLevelExpr(FnAST, resolveCallee, Result);
         }
+        if (Interpreted) {
+            fprintf(stderr, "Evaluated to %f\n", Result);
+            return nullptr;
+        }
+    }
+
+    Function *FnIR;
+    {
+        TimeRegion Region(phaseTimer(CodegenTimer));
+        FnIR = codegenFunction(CG, FnAST);
+    }
+    if (FnIR) {
+        fprintf(stderr, "Read top-level expression: ");
+        FnIR->print(errs());
+        fprintf(stderr, "\n");
+        if (TheJIT) {
+            runTopLevelExpression(CG, FnIR);
+        }
+    }
+    return FnIR;
+}
+
+static void
+HandleDefinition(Parser &P, CodegenContext &CG) {
+    if (auto FnAST = P.ParseDefinition()) {
+        EmitDefinition(CG, *FnAST);
     } else {
         // skip token for error recovery
-        getNextToken();
+        P.skipToNextTopLevel();
     }
 }
 
-static void HandleExtern() {
-    if (auto ProtoAST = ParseExtern()) {
-        if (auto *FnIR = ProtoAST->codegen()) {
-            fprintf(stderr, "Read extern: ");
-            FnIR->print(errs());
-            fprintf(stderr, "\n");
-        }
+static void HandleExtern(Parser &P, CodegenContext &CG) {
+    if (auto ProtoAST = P.ParseExtern()) {
+        EmitExtern(CG, *ProtoAST);
     } else {
         // skip token for error recovery
-        getNextToken();
+        P.skipToNextTopLevel();
     }
 }
 
-static void HandleTopLevelExpression() {
+static void HandleTopLevelExpression(Parser &P, CodegenContext &CG) {
     // Evaluate a top top-level expression inti a anonymous function
-    if (auto FnAST = ParseTopLevelExpr()) {
-        if (auto *FnIR = FnAST->codegen()) {
-            fprintf(stderr, "Read top-level expression: ");
-            FnIR->print(errs());
-            fprintf(stderr, "\n");
-        }
+    if (auto FnAST = P.ParseTopLevelExpr()) {
+        EmitTopLevelExpression(CG, *FnAST);
     } else {
         //skip token for error recovery
-        getNextToken();
+        P.skipToNextTopLevel();
     }
 }
 
 /// top ::= definition | external | expression | ;
-static void MainLoop() {
+static void MainLoop(Parser &P, CodegenContext &CG) {
     while (1) {
         fprintf(stderr, "ready>");
-        switch (CurTok) {
+        switch (P.getCurTok()) {
             case tok_eof:
                 return;
             case ';':  //ignore top-level semicolons
-                getNextToken();
+                P.getNextToken();
                 break;
             case tok_def:
-                HandleDefinition();
+                HandleDefinition(P, CG);
                 break;
             case tok_extern:
-                HandleExtern();
+                HandleExtern(P, CG);
                 break;
             default:
-                HandleTopLevelExpression();
+                HandleTopLevelExpression(P, CG);
                 break;
         }
     }
 }
 
+//parse on this many threads before generating any code, 1 keeps the item by item loop
+static cl::opt<unsigned> ParseThreads("parse-threads",
+                                      cl::desc("Parse the whole input on N threads first (0 = one per core)"),
+                                      cl::init(1));
+
+static Function *EmitItem(CodegenContext &CG, TopLevelItem &Item) {
+    switch (Item.Kind) {
+        case TopLevelItem::Definition:
+            return EmitDefinition(CG, *Item.Function);
+        case TopLevelItem::Extern:
+            return EmitExtern(CG, *Item.Proto);
+        case TopLevelItem::Expression:
+            return EmitTopLevelExpression(CG, *Item.Function);
+    }
+    llvm_unreachable("unknown top-level item");
+}
+
+/// BatchLoop - parse the whole input in parallel, then generate code for the
+/// items in source order
+static void BatchLoop(SourceBuffer &Source, CodegenContext &CG) {
+    for (auto &Item : parseTopLevelItems(Source, ParseThreads)) {
+        EmitItem(CG, Item);
+    }
+}
+
+//generate code for the definitions on this many threads, each into a module of its own
+static cl::opt<unsigned> CodegenThreads("codegen-threads",
+                                        cl::desc("Generate code for the definitions on N threads (0 = one per core)"),
+                                        cl::init(1));
+
+/// isCalledAfterFailing - whether any of Contexts calls a definition that
+/// failed to compile, Functions[I] is the result for Defs[I]
+static bool isCalledAfterFailing(ArrayRef<FunctionAST *> Defs, ArrayRef<Function *> Functions,
+                                 ArrayRef<std::unique_ptr<CodegenContext>> Contexts) {
+    for (size_t I = 0, E = Defs.size(); I != E; ++I) {
+        if (Functions[I]) {
+            continue;
+        }
+        StringRef Name = getSymbolName(Defs[I]->getProto().getName());
+        for (auto &Ctx : Contexts) {
+            Function *Decl = Ctx->getModule().getFunction(Name);
+            if (Decl && !Decl->use_empty()) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/// ParallelLoop - parse the whole input, generate code for all definitions on
+/// CodegenThreads threads, hand their modules to the JIT (or print them) and
+/// then generate and run the top-level expressions in source order.
+/// Unlike the item by item loops every definition exists before the first
+/// expression runs, and only the first definition of a name is compiled.
+static bool ParallelLoop(SourceBuffer &Source, CodegenContext &CG) {
+    auto Items = parseTopLevelItems(Source, ParseThreads);
+
+    //every prototype is known before the first thread starts, the threads only read them
+    std::vector<FunctionAST *> Defs;
+    for (auto &Item : Items) {
+        if (TopLevelItem::Extern == Item.Kind) {
+            addFunctionProto(*Item.Proto);
+            continue;
+        }
+        if (TopLevelItem::Definition != Item.Kind) {
+            continue;
+        }
+        PrototypeAST &Proto = Item.Function->getProto();
+        if (!DefinedFunctions.insert(Proto.getName()).second) {
+            LogError("Function cannot be redefined.");
+            continue;
+        }
+        auto It = FunctionProtos.find(Proto.getName());
+        if (It != FunctionProtos.end() && It->second->getNumArgs() != Proto.getNumArgs()) {
+            LogError("Definition does not match the # arguments of its extern");
+            continue;
+        }
+        addFunctionProto(Proto);
+        //in source order, a definition may rely on the ones before being found pure
+        if (Memo) {
+            Memo->addDefinition(*Item.Function);
+        }
+        Defs.push_back(Item.Function.get());
+    }
+
+    //every name is defined once here, its table cannot be a stale one
+    auto Emit = [](CodegenContext &WorkerCG, FunctionAST &FnAST) {
+        if (Memo) {
+            WorkerCG.setMemoTable(Memo->lookup(FnAST.getProto().getName()));
+        }
+        return codegenFunction(WorkerCG, FnAST);
+    };
+    //each worker optimizes its own module, with a TargetMachine of its own
+    auto Finish = [](CodegenContext &WorkerCG) {
+        std::unique_ptr<TargetMachine> TM(TheJIT ? cloneTargetMachine(TheJIT->getTargetMachine()) : nullptr);
+        optimizeModule(WorkerCG.getModule(), OptimizeLevel, TM.get());
+    };
+    std::vector<Function *> Functions;
+    std::vector<std::unique_ptr<CodegenContext>> Contexts;
+    {
+        //the timers are not thread safe, the workers' optimization counts as code generation
+        TimeRegion Region(phaseTimer(CodegenTimer));
+        Contexts = compileInParallel(Defs, FunctionProtos, CG.getModule().getDataLayout(),
+                                     getFastMathFlags(FloatingPointMode), CodegenThreads, Emit, Finish,
+                                     Functions);
+    }
+    if (TheJIT && isCalledAfterFailing(Defs, Functions, Contexts)) {
+        //the calls would not link
+        LogError("A called definition failed to compile, not running the program");
+        return false;
+    }
+    for (size_t I = 0, E = Defs.size(); Batch && I != E; ++I) {
+        if (Functions[I]) {
+            Batch->addDefinition(*Defs[I]);
+        }
+    }
+    for (auto &Ctx : Contexts) {
+        if (TheJIT) {
+            TimeRegion Region(phaseTimer(JITTimer));
+            TheJIT->addModule(Ctx->takeModule());
+        } else {
+            Ctx->getModule().print(errs(), nullptr);
+        }
+    }
+    Contexts.clear();
+
+    for (auto &Item : Items) {
+        if (TopLevelItem::Expression == Item.Kind) {
+            EmitTopLevelExpression(CG, *Item.Function);
+        }
+    }
+    return true;
+}
+
+//later versions of the input script, each loaded over the previous one
+static cl::list<std::string> ReloadFilenames("reload", cl::desc("Reload the script from <file> afterwards, "
+                                                                "reusing the definitions that did not change"),
+                                             cl::value_desc("file"));
+
+/// ReloadLoop - load the input and then every -reload file through one
+/// DefinitionCache
+static bool ReloadLoop(SourceBuffer &Source, CodegenContext &CG) {
+    DefinitionCache Cache(CG);
+    auto Emit = [&](TopLevelItem &Item) { return EmitItem(CG, Item); };
+    Cache.load(Source, Emit);
+    for (auto &Filename : ReloadFilenames) {
+        auto NewSource = SourceBuffer::create(Filename);
+        if (!NewSource || NewSource->isInteractive()) {
+            return false;
+        }
+        auto Stats = Cache.load(*NewSource, Emit);
+        fprintf(stderr, "Reloaded %s: %u reused, %u reparsed, %u recompiled, %u removed\n", Filename.c_str(),
+                Stats.Reused, Stats.Reparsed, Stats.Recompiled, Stats.Removed);
+    }
+    return true;
+}
+
+/// readColumns - the numbers in Filename, row after row, split into NumColumns
+/// columns
+static bool readColumns(StringRef Filename, size_t NumColumns, std::vector<std::vector<double>> &Columns) {
+    auto Source = SourceBuffer::create(Filename);
+    if (!Source) {
+        return false;
+    }
+    if (Source->isInteractive()) {
+        LogError("The batch input must be a file or a pipe");
+        return false;
+    }
+    Columns.assign(NumColumns, std::vector<double>());
+    size_t NumValues = 0;
+    //the buffer ends in a '\0', strtod stops there
+    for (const char *P = Source->begin();; ++NumValues) {
+        while (isspace((unsigned char)*P)) {
+            ++P;
+        }
+        if (P == Source->end()) {
+            break;
+        }
+        char *NumEnd;
+        double Val = strtod(P, &NumEnd);
+        if (NumEnd == P) {
+            LogError("Invalid number in the batch input");
+            return false;
+        }
+        Columns[NumValues % NumColumns].push_back(Val);
+        P = NumEnd;
+    }
+    if (NumValues % NumColumns) {
+        LogError("The batch input does not have a number for every argument of each row");
+        return false;
+    }
+    return true;
+}
+
+/// runBatch - evaluate -batch over -batch-input through a compiled kernel
+static bool runBatch() {
+    SymbolID Name = internSymbol(BatchFunction);
+    BatchKernel Kernel;
+    {
+        TimeRegion Region(phaseTimer(JITTimer));
+        Kernel = Batch->compileKernel(Name);
+    }
+    if (!Kernel) {
+        return false;
+    }
+    size_t NumArgs = FunctionProtos.find(Name)->second->getNumArgs();
+    if (!NumArgs) {
+        LogError("Batch evaluation needs a function with arguments");
+        return false;
+    }
+    std::vector<std::vector<double>> Columns;
+    if (!readColumns(BatchInput, NumArgs, Columns)) {
+        return false;
+    }
+    std::vector<const double *> ColumnPtrs;
+    for (auto &Column : Columns) {
+        ColumnPtrs.push_back(Column.data());
+    }
+    std::vector<double> Results(Columns[0].size());
+    {
+        TimeRegion Region(phaseTimer(RunTimer));
+        Kernel(ColumnPtrs.data(), Results.data(), Results.size());
+    }
+    for (double Result : Results) {
+        printf("%f\n", Result);
+    }
+    return true;
+}
+
 //===----------------------------------------------------------------------===//
 // Main driver code.
 //===----------------------------------------------------------------------===//
 
-int main() {
-    // Install standard binary operators
-    // 1 is lowest precedence
-    BinopPrecedence['<'] = 10;
-    BinopPrecedence['+'] = 20;
-    BinopPrecedence['-'] = 20;
-    BinopPrecedence['*'] = 40;  //hihest
+static cl::opt<std::string> InputFilename(cl::Positional, cl::desc("<input file>"), cl::init("-"));
 
-    //prime the first token
-    fprintf(stderr, "ready> ");
-    getNextToken();
+//the lexer picks the widest scanner the cpu has, this forces a narrower one,
+//e.g. to compare the token streams of the simd and scalar paths
+static cl::opt<ScanISA> LexerISA("scan", cl::desc("Character scanning used by the lexer"),
+                                 cl::values(clEnumValN(scan_scalar, "scalar", "one byte at a time"),
+                                            clEnumValN(scan_sse2, "sse2", "16 bytes per step"),
+                                            clEnumValN(scan_avx2, "avx2", "32 bytes per step")),
+                                 cl::init(getHostScanISA()));
+
+//list what the lexer makes of the input instead of compiling it, e.g. to diff the -scan paths
+static cl::opt<bool> DumpTokens("dump-tokens", cl::desc("Print the tokens of the input, one per line, and exit"));
+
+/// dumpTokens - every token with its byte offset: the spelling of an
+/// identifier, the exact bits of a number, the value of anything else
+static void dumpTokens(SourceBuffer &Source) {
+    Lexer Lex(Source);
+    for (int Tok = Lex.gettok(); Tok != tok_eof; Tok = Lex.gettok()) {
+        size_t Offset = Source.isInteractive() ? 0 : Lex.getTokenOffset();
+        if (tok_identifier == Tok) {
+            printf("%zu identifier %s\n", Offset, getSymbolName(Lex.getIdentifier()).str().c_str());
+        } else if (tok_number == Tok) {
+            printf("%zu number %a\n", Offset, Lex.getNumVal());
+        } else {
+            printf("%zu token %d\n", Offset, Tok);
+        }
+    }
+}
+
+//lex the whole input before parsing, a syntax error then skips straight to the next def/extern
+static cl::opt<bool> Pretokenize("pretokenize", cl::desc("Lex the whole input before parsing it"));
+
+static cl::opt<bool> UseJIT("jit", cl::desc("Compile with the JIT and evaluate the top-level expressions"));
+
+//the JIT's code only runs here, so by default it may use every unit of this cpu
+static cl::opt<std::string> TargetCPU("mcpu",
+                                      cl::desc("The CPU the JIT generates code for ('host' is this one, with all "
+                                               "of its features)"),
+                                      cl::value_desc("cpu-name"), cl::init("host"));
+static cl::list<std::string> TargetAttrs("mattr", cl::CommaSeparated,
+                                         cl::desc("Target features for the JIT to enable (+feature) or disable "
+                                                  "(-feature) on top of the CPU's"),
+                                         cl::value_desc("a1,+a2,-a3,..."));
+
+/// createJIT - a JIT for -mcpu and -mattr, reporting the target it selected
+static std::unique_ptr<orc::KaleidoscopeJIT> createJIT() {
+    std::string CPU = TargetCPU;
+    std::vector<std::string> Attrs;
+    if ("host" == CPU) {
+        CPU = sys::getHostCPUName().str();
+        StringMap<bool> HostFeatures;
+        if (sys::getHostCPUFeatures(HostFeatures)) {
+            for (auto &Feature : HostFeatures) {
+                Attrs.push_back((Feature.second ? "+" : "-") + Feature.first().str());
+            }
+        }
+    }
+    //after the host's, so they win
+    Attrs.insert(Attrs.end(), TargetAttrs.begin(), TargetAttrs.end());
+    auto JIT = llvm::make_unique<orc::KaleidoscopeJIT>(CPU, Attrs);
+
+    TargetMachine &TM = JIT->getTargetMachine();
+    //the host's features list the ones it lacks as well, only -mattr's are worth reporting
+    SmallVector<StringRef, 64> Features, Enabled, Disabled;
+    for (StringRef Feature : TargetAttrs) {
+        if (Feature.consume_front("-")) {
+            Disabled.push_back(Feature);
+        }
+    }
+    TM.getTargetFeatureString().split(Features, ',', -1, false);
+    for (StringRef Feature : Features) {
+        if (Feature.consume_front("+") && !is_contained(Disabled, Feature)) {
+            Enabled.push_back(Feature);
+        }
+    }
+    llvm::sort(Enabled.begin(), Enabled.end());
+    fprintf(stderr, "JIT target: %s, cpu %s, features %s%s%s\n", TM.getTargetTriple().str().c_str(),
+            TM.getTargetCPU().str().c_str(), Enabled.empty() ? "of the cpu" : join(Enabled, ",").c_str(),
+            Disabled.empty() ? "" : ", without ", join(Disabled, ",").c_str());
+    return JIT;
+}
+
+//with the JIT the code is gone into it, with the VM there never was any
+static void printModule(CodegenContext &CG) {
+    if (!TheJIT && !TheVM) {
+        optimize(CG.getModule());
+        CG.getModule().print(errs(), nullptr);
+    }
+}
+
+int main(int argc, char **argv) {
+    cl::ParseCommandLineOptions(argc, argv, "Kaleidoscope compiler\n");
+    setScanISA(LexerISA);
+
+    //read the whole file (or pipe) up front, a terminal line by line
+    auto Source = SourceBuffer::create(InputFilename);
+    if (!Source) {
+        return 1;
+    }
+    if (DumpTokens) {
+        dumpTokens(*Source);
+        return 0;
+    }
+
+    if (UseVM) {
+        //the VM replaces all of LLVM's code generation
+        if (UseJIT || !ReloadFilenames.empty() || CodegenThreads != 1) {
+            LogError("-vm does not support -jit, -reload or -codegen-threads");
+            return 1;
+        }
+        TheVM = llvm::make_unique<BytecodeVM>();
+    }
+
+    if (UseJIT) {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+        InitializeNativeTargetAsmParser();
+        TheJIT = createJIT();
+        TheJIT->getTargetMachine().setOptLevel(getCodeGenOptLevel(OptimizeLevel));
+        setFPOptions(TheJIT->getTargetMachine(), FloatingPointMode);
+    }
+    if (!BatchFunction.empty()) {
+        if (!TheJIT || BatchInput.empty()) {
+            LogError("-batch needs -jit and -batch-input");
+            return 1;
+        }
+        Batch = llvm::make_unique<BatchEvaluator>(*TheJIT, JITLock, FunctionProtos,
+                                                   getFastMathFlags(FloatingPointMode));
+    }
+
+    if (Memoize) {
+        if (!TheJIT || Tiered) {
+            LogError("-memoize needs -jit and does not support -tiered");
+            return 1;
+        }
+        Memo = llvm::make_unique<Memoizer>(MemoEntries);
+    }
 
     //Make the module, which holds all the code.
-    TheModule = llvm::make_unique<Module>("my first coder", TheContext);
+    CodegenContext CG("my first coder", &FunctionProtos);
+    CG.setFastMathFlags(getFastMathFlags(FloatingPointMode));
+    if (TheJIT) {
+        CG.getModule().setDataLayout(TheJIT->getTargetMachine().createDataLayout());
+    }
+    if (TheJIT && Tiered && 1 == CodegenThreads) {
+        Tiers = llvm::make_unique<TieredCompiler>(*TheJIT, JITLock, FunctionProtos,
+                                                   getFastMathFlags(FloatingPointMode), TierUpThreshold);
+        Tiers->prepare(CG);
+    }
+    //the tiered baseline calls through slots, there is nothing to inline. The
+    //-codegen-threads workers optimize all definitions at once, none is in the JIT yet
+    bool Parallel = CodegenThreads != 1 && !Source->isInteractive();
+    if (TheJIT && OptimizeLevel >= opt_O2 && ImportDefinitions && !Tiers && !Parallel) {
+        Library = llvm::make_unique<DefinitionLibrary>(ImportLimit);
+    }
+
+    if (!ReloadFilenames.empty() && !Source->isInteractive()) {
+        //the cache patches functions inside one module
+        if (TheJIT) {
+            LogError("-reload does not support -jit");
+            return 1;
+        }
+        if (!ReloadLoop(*Source, CG)) {
+            return 1;
+        }
+        printModule(CG);
+        return 0;
+    }
+
+    if (Parallel) {
+        if (!ParallelLoop(*Source, CG) || (Batch && !runBatch())) {
+            return 1;
+        }
+        stopMemoizing();
+        stopImporting();
+        printModule(CG);
+        return 0;
+    }
+
+    if (ParseThreads != 1 && !Source->isInteractive()) {
+        BatchLoop(*Source, CG);
+        stopTiering();
+        stopMemoizing();
+        stopImporting();
+        printModule(CG);
+        return Batch && !runBatch();
+    }
+
+    Lexer Lex(*Source);
+    TokenBuffer Toks;
+    //the parser installs the standard binary operators
+    std::unique_ptr<Parser> P;
+    if (Pretokenize && !Source->isInteractive()) {
+        Toks.tokenize(Lex);
+        P = llvm::make_unique<Parser>(Toks);
+    } else {
+        P = llvm::make_unique<Parser>(Lex);
+    }
+
+    //prime the first token
+    fprintf(stderr, "ready> ");
+    P->getNextToken();
 
     //Run the main "interpreter loop" now.
-    MainLoop();
+    MainLoop(*P, CG);
+    stopTiering();
+    stopMemoizing();
+    stopImporting();
 
     // print out all of the generated code
-    TheModule->print(errs(), nullptr);
+    printModule(CG);
 
-    return 0;
+    return Batch && !runBatch();
 }
@@ -0,0 +1,106 @@
+#include "AST.h"
+#include "Bytecode.h"
+#include "Error.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Scan.h"
+#include "SourceBuffer.h"
+#include "llvm/Support/CommandLine.h"
+//===----------------------------------------------------------------------===//
+// toyvm - the bytecode VM of toy -vm on its own
+//===----------------------------------------------------------------------===//
+// Built from the lexer, the parser and the VM only, without the code
+// generator and with nothing of LLVM but its Support library, for hosts where
+// a small binary or a short build matters more than the speed of the JIT.
+
+static cl::opt<std::string> InputFilename(cl::Positional, cl::desc("<input file>"), cl::init("-"));
+
+static cl::opt<ScanISA> LexerISA("scan", cl::desc("Character scanning used by the lexer"),
+                                 cl::values(clEnumValN(scan_scalar, "scalar", "one byte at a time"),
+                                            clEnumValN(scan_sse2, "sse2", "16 bytes per step"),
+                                            clEnumValN(scan_avx2, "avx2", "32 bytes per step")),
+                                 cl::init(getHostScanISA()));
+
+static cl::opt<bool> SimplifyAST("simplify", cl::desc("Simplify expressions before compiling them to bytecode"),
+                                 cl::init(true));
+
+static void HandleDefinition(Parser &P, BytecodeVM &VM) {
+    if (auto FnAST = P.ParseDefinition()) {
+        if (SimplifyAST) {
+            FnAST->simplify();
+        }
+        if (VM.addDefinition(*FnAST)) {
+            fprintf(stderr, "Read function definition: %s\n", getSymbolName(FnAST->getProto().getName()).str().c_str());
+        }
+    } else {
+        // skip token for error recovery
+        P.skipToNextTopLevel();
+    }
+}
+
+static void HandleExtern(Parser &P, BytecodeVM &VM) {
+    if (auto ProtoAST = P.ParseExtern()) {
+        VM.addExtern(*ProtoAST);
+        fprintf(stderr, "Read extern: %s\n", getSymbolName(ProtoAST->getName()).str().c_str());
+    } else {
+        // skip token for error recovery
+        P.skipToNextTopLevel();
+    }
+}
+
+static void HandleTopLevelExpression(Parser &P, BytecodeVM &VM) {
+    if (auto FnAST = P.ParseTopLevelExpr()) {
+        if (SimplifyAST) {
+            FnAST->simplify();
+        }
+        double Result;
+        if (VM.evaluate(*FnAST, Result)) {
+            fprintf(stderr, "Evaluated to %f\n", Result);
+        }
+    } else {
+        //skip token for error recovery
+        P.skipToNextTopLevel();
+    }
+}
+
+/// top ::= definition | external | expression | ;
+static void MainLoop(Parser &P, BytecodeVM &VM) {
+    while (1) {
+        fprintf(stderr, "ready>");
+        switch (P.getCurTok()) {
+            case tok_eof:
+                return;
+            case ';':  //ignore top-level semicolons
+                P.getNextToken();
+                break;
+            case tok_def:
+                HandleDefinition(P, VM);
+                break;
+            case tok_extern:
+                HandleExtern(P, VM);
+                break;
+            default:
+                HandleTopLevelExpression(P, VM);
+                break;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    cl::ParseCommandLineOptions(argc, argv, "Kaleidoscope bytecode VM\n");
+    setScanISA(LexerISA);
+
+    auto Source = SourceBuffer::create(InputFilename);
+    if (!Source) {
+        return 1;
+    }
+    BytecodeVM VM;
+    Lexer Lex(*Source);
+    Parser P(Lex);
+
+    //prime the first token
+    fprintf(stderr, "ready> ");
+    P.getNextToken();
+    MainLoop(P, VM);
+    return 0;
+}